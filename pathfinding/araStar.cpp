@@ -0,0 +1,166 @@
+#include "araStar.h"
+#include "searchContext.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+
+template<typename T>
+static size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+// closed node which got a better g after expansion, waits in incons for the next pass
+constexpr uint8_t NS_INCONS = NS_CLOSED + 1;
+
+float AraStarPlanner::f_value(size_t idx) const
+{
+  return g[idx] + weight * heuristic(Position{int(idx % width), int(idx / width)}, to);
+}
+
+void AraStarPlanner::start(const char *grid, size_t grid_width, size_t grid_height, Position from_pos, Position to_pos,
+                           float initial_weight, float weight_step)
+{
+  input = grid;
+  width = grid_width;
+  height = grid_height;
+  from = from_pos;
+  to = to_pos;
+  weight = std::max(1.f, initial_weight);
+  weightStep = std::max(0.01f, weight_step);
+  suboptimality = 0.f;
+  hasPath = false;
+  finished = false;
+  g.assign(width * height, std::numeric_limits<float>::max());
+  prev.assign(width * height, invalid_node);
+  state.assign(width * height, NS_UNSEEN);
+  closedIn.assign(width * height, 0);
+  pass = 1;
+  incons.clear();
+  openList.reset(width * height);
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height) ||
+      to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+  {
+    finished = true;
+    return;
+  }
+  const size_t fromIdx = coord_to_idx(from.x, from.y, width);
+  g[fromIdx] = 0.f;
+  state[fromIdx] = NS_OPEN;
+  openList.push(fromIdx, f_value(fromIdx));
+}
+
+bool AraStarPlanner::improve_path(std::chrono::steady_clock::time_point deadline, bool has_deadline,
+                                  size_t &nodes_expanded, const ExpandCallback &on_expand)
+{
+  const size_t toIdx = coord_to_idx(to.x, to.y, width);
+  while (!openList.empty() && g[toIdx] > openList.top_key())
+  {
+    // clock is checked every 64 nodes, it costs more than an expansion
+    if (has_deadline && (nodes_expanded & 63) == 0 && std::chrono::steady_clock::now() >= deadline)
+      return false;
+    const size_t idx = openList.pop();
+    state[idx] = NS_UNSEEN;
+    closedIn[idx] = pass;
+    ++nodes_expanded;
+    const Position curPos{int(idx % width), int(idx / width)};
+    if (on_expand)
+      on_expand(curPos, g[idx]);
+    auto checkNeighbour = [&](Position p)
+    {
+      // out of bounds
+      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+        return;
+      const size_t nidx = coord_to_idx(p.x, p.y, width);
+      // not empty
+      if (input[nidx] == dungeon::wall)
+        return;
+      const float gScore = g[idx] + (input[nidx] == dungeon::water ? 10.f : 1.f);
+      if (gScore >= g[nidx])
+        return;
+      g[nidx] = gScore;
+      prev[nidx] = idx;
+      if (closedIn[nidx] == pass)
+      {
+        if (state[nidx] != NS_INCONS)
+        {
+          state[nidx] = NS_INCONS;
+          incons.push_back(nidx);
+        }
+      }
+      else if (state[nidx] == NS_OPEN)
+        openList.decrease_key(nidx, f_value(nidx));
+      else
+      {
+        state[nidx] = NS_OPEN;
+        openList.push(nidx, f_value(nidx));
+      }
+    };
+    checkNeighbour({curPos.x + 1, curPos.y + 0});
+    checkNeighbour({curPos.x - 1, curPos.y + 0});
+    checkNeighbour({curPos.x + 0, curPos.y + 1});
+    checkNeighbour({curPos.x + 0, curPos.y - 1});
+  }
+  return true;
+}
+
+void AraStarPlanner::next_pass()
+{
+  weight = std::max(1.f, weight - weightStep);
+  // open nodes get keys with the new weight, inconsistent ones join them, nothing else is touched
+  openList.rekey([&](size_t idx) { return f_value(idx); });
+  for (size_t idx : incons)
+  {
+    state[idx] = NS_OPEN;
+    openList.push(idx, f_value(idx));
+  }
+  incons.clear();
+  // closed set is emptied by moving to the next pass stamp
+  if (++pass == 0)
+  {
+    std::fill(closedIn.begin(), closedIn.end(), 0);
+    pass = 1;
+  }
+}
+
+bool AraStarPlanner::improve(float budget_us, std::vector<Position> &out_path, PathStats *stats,
+                             const ExpandCallback &on_expand)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(int64_t(budget_us));
+  size_t nodesExpanded = 0;
+  while (!finished)
+  {
+    if (!improve_path(deadline, hasPath, nodesExpanded, on_expand))
+      break;
+    if (g[coord_to_idx(to.x, to.y, width)] == std::numeric_limits<float>::max())
+    {
+      finished = true; // no path at all
+      break;
+    }
+    hasPath = true;
+    suboptimality = weight;
+    if (weight <= 1.f)
+    {
+      finished = true;
+      break;
+    }
+    next_pass();
+    if (std::chrono::steady_clock::now() >= deadline)
+      break;
+  }
+  if (stats)
+    stats->nodesExpanded = nodesExpanded;
+
+  out_path.clear();
+  if (!hasPath)
+    return false;
+  // g only decreases, so prev links stay a valid tree even in the middle of a pass
+  size_t len = 0;
+  const size_t toIdx = coord_to_idx(to.x, to.y, width);
+  for (size_t idx = toIdx; idx != invalid_node; idx = prev[idx])
+    ++len;
+  out_path.resize(len);
+  for (size_t idx = toIdx; idx != invalid_node; idx = prev[idx])
+    out_path[--len] = Position{int(idx % width), int(idx / width)};
+  return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "pathfinder.h"
+#include "indexedHeap.h"
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Anytime Repairing A*, finds an inflated path quickly and then lowers the weight towards 1 on later calls,
+// nodes which became inconsistent are kept between passes so each pass continues instead of restarting
+class AraStarPlanner
+{
+public:
+  void start(const char *grid, size_t grid_width, size_t grid_height, Position from_pos, Position to_pos,
+             float initial_weight = 3.f, float weight_step = 0.5f);
+  // searches for about budget_us microseconds, the first call doesn't stop before a path is found
+  // writes the best path so far and returns false if there's none
+  bool improve(float budget_us, std::vector<Position> &out_path, PathStats *stats = nullptr,
+               const ExpandCallback &on_expand = {});
+
+  bool is_started() const { return input != nullptr; }
+  bool is_optimal() const { return finished; }
+  // cost of the returned path is at most this many times the optimal one
+  float get_suboptimality() const { return suboptimality; }
+
+private:
+  const char *input = nullptr;
+  size_t width = 0;
+  size_t height = 0;
+  Position from;
+  Position to;
+  float weight = 1.f;
+  float weightStep = 0.5f;
+  float suboptimality = 0.f;
+  bool hasPath = false;
+  bool finished = false;
+  std::vector<float> g;
+  std::vector<size_t> prev;
+  std::vector<uint8_t> state; // NS_OPEN, NS_INCONS or NS_UNSEEN, closed nodes are told by closedIn
+  std::vector<uint32_t> closedIn; // pass which expanded the node, a new pass reopens all of them at once
+  uint32_t pass = 1;
+  std::vector<size_t> incons;
+  IndexedHeap openList;
+
+  float f_value(size_t idx) const;
+  bool improve_path(std::chrono::steady_clock::time_point deadline, bool has_deadline, size_t &nodes_expanded,
+                    const ExpandCallback &on_expand);
+  void next_pass();
+};
@@ -0,0 +1,271 @@
+// headless benchmark for grid searches, doesn't need a window so it can run on CI
+// usage:
+//   pathfinding_bench [--map file.map [--scen file.scen]] [--size 256] [--seed 1] [--queries 1000]
+//                     [--ida-queries 50] [--ida-limit 1000000] [--ida-table 65536] [--landmarks 8]
+// without --map a drunk dungeon of the given size is generated from the seed
+#include "../dungeonGen.h"
+#include "../dungeonUtils.h"
+#include "../pathfinder.h"
+#include "../jumpPointSearch.h"
+#include "../landmarks.h"
+#include "../idaStar.h"
+#include "../araStar.h"
+#include "../bidirectionalAStar.h"
+#include "movingAi.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct BenchSettings
+{
+  std::string mapPath;
+  std::string scenPath;
+  size_t size = 256;
+  unsigned seed = 1;
+  size_t numQueries = 1000;
+  size_t numIdaQueries = 50;
+  size_t idaLimit = 1000000;
+  size_t idaTableSize = 65536;
+  size_t numLandmarks = 8;
+};
+
+struct BenchQuery
+{
+  Position from;
+  Position to;
+};
+
+static bool parse_args(int argc, const char **argv, BenchSettings &settings)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *arg = argv[i];
+    if (i + 1 >= argc)
+    {
+      printf("missing value for '%s'\n", arg);
+      return false;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--map") == 0)
+      settings.mapPath = value;
+    else if (strcmp(arg, "--scen") == 0)
+      settings.scenPath = value;
+    else if (strcmp(arg, "--size") == 0)
+      settings.size = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--seed") == 0)
+      settings.seed = unsigned(strtoul(value, nullptr, 10));
+    else if (strcmp(arg, "--queries") == 0)
+      settings.numQueries = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--ida-queries") == 0)
+      settings.numIdaQueries = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--ida-limit") == 0)
+      settings.idaLimit = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--ida-table") == 0)
+      settings.idaTableSize = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--landmarks") == 0)
+      settings.numLandmarks = strtoul(value, nullptr, 10);
+    else
+    {
+      printf("unknown argument '%s'\n", arg);
+      return false;
+    }
+  }
+  return true;
+}
+
+static float path_cost(const GridMap &map, const std::vector<Position> &path)
+{
+  float cost = 0.f;
+  for (size_t i = 1; i < path.size(); ++i)
+    cost += map.tiles[size_t(path[i].y) * map.width + size_t(path[i].x)] == dungeon::water ? 10.f : 1.f;
+  return cost;
+}
+
+using SearchFn = std::function<bool(Position from, Position to, std::vector<Position> &path, PathStats &stats)>;
+
+// runs the search over all queries and prints a row of the report
+// path costs are compared to the reference ones, negative reference means there's no path
+static void run_algorithm(const char *name, const GridMap &map, const std::vector<BenchQuery> &queries,
+                          const std::vector<float> &reference_costs, const SearchFn &search)
+{
+  std::vector<double> latencies;
+  latencies.reserve(queries.size());
+  std::vector<Position> path;
+  size_t numFound = 0;
+  size_t numMismatches = 0;
+  size_t expanded = 0;
+  double totalUs = 0.0;
+  for (size_t i = 0; i < queries.size(); ++i)
+  {
+    PathStats stats;
+    const auto startTime = std::chrono::steady_clock::now();
+    const bool found = search(queries[i].from, queries[i].to, path, stats);
+    const auto endTime = std::chrono::steady_clock::now();
+    const double us = std::chrono::duration<double, std::micro>(endTime - startTime).count();
+    latencies.push_back(us);
+    totalUs += us;
+    expanded += stats.nodesExpanded;
+    if (found)
+      ++numFound;
+    if (i < reference_costs.size() && (found ? path_cost(map, path) : -1.f) != reference_costs[i])
+      ++numMismatches;
+  }
+  if (queries.empty())
+    return;
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) { return latencies[std::min(latencies.size() - 1, size_t(p * double(latencies.size())))]; };
+  const double n = double(queries.size());
+  printf("%-8s %8zu %6zu %12.1f %10.2f %10.2f %10.2f %12.1f %10zu\n", name, queries.size(), numFound,
+         n / (totalUs * 1e-6), totalUs / n, percentile(0.5), percentile(0.99), double(expanded) / n, numMismatches);
+}
+
+int main(int argc, const char **argv)
+{
+  BenchSettings settings;
+  if (!parse_args(argc, argv, settings))
+    return 1;
+
+  GridMap map;
+  std::vector<BenchQuery> queries;
+  if (!settings.mapPath.empty())
+  {
+    if (!load_movingai_map(settings.mapPath, map))
+      return 1;
+    if (!settings.scenPath.empty())
+    {
+      std::vector<ScenarioQuery> scenario;
+      if (!load_movingai_scen(settings.scenPath, map, scenario))
+        return 1;
+      for (const ScenarioQuery &query : scenario)
+        if (queries.size() < settings.numQueries)
+          queries.push_back({query.from, query.to});
+    }
+  }
+  else
+  {
+    map.width = map.height = settings.size;
+    map.tiles.resize(map.width * map.height);
+    gen_drunk_dungeon(map.tiles.data(), map.width, map.height, 24, map.width * map.height / 40, settings.seed);
+  }
+
+  std::vector<size_t> floorTiles;
+  for (size_t idx = 0; idx < map.tiles.size(); ++idx)
+    if (map.tiles[idx] != dungeon::wall)
+      floorTiles.push_back(idx);
+  if (floorTiles.empty())
+  {
+    printf("map has no walkable tiles\n");
+    return 1;
+  }
+  if (queries.empty())
+  {
+    std::mt19937 rng(settings.seed);
+    std::uniform_int_distribution<size_t> tileDist(0, floorTiles.size() - 1);
+    auto randomTile = [&]()
+    {
+      const size_t idx = floorTiles[tileDist(rng)];
+      return Position{int(idx % map.width), int(idx / map.width)};
+    };
+    for (size_t i = 0; i < settings.numQueries; ++i)
+      queries.push_back({randomTile(), randomTile()});
+  }
+  printf("map %zux%zu, %zu walkable tiles, %zu queries\n", map.width, map.height, floorTiles.size(), queries.size());
+
+  const char *tiles = map.tiles.data();
+  SearchContext &ctx = get_thread_search_context();
+  // plain A* results are the reference for everything else
+  std::vector<float> referenceCosts;
+  {
+    std::vector<Position> path;
+    for (const BenchQuery &query : queries)
+      referenceCosts.push_back(find_path_a_star(ctx, tiles, map.width, map.height, query.from, query.to, 1.f, path)
+                               ? path_cost(map, path) : -1.f);
+  }
+
+  const auto buildStart = std::chrono::steady_clock::now();
+  const LandmarkTable landmarks = build_landmarks(tiles, map.width, map.height, settings.numLandmarks);
+  const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+  printf("%zu landmarks: %zu KB, built in %.2f ms\n", landmarks.landmarks.size(), landmarks.memory_bytes() / 1024, buildMs);
+  const bool weightedTiles = has_weighted_tiles(tiles, map.width, map.height);
+
+  printf("%-8s %8s %6s %12s %10s %10s %10s %12s %10s\n", "algo", "queries", "found", "queries/s", "mean us",
+         "p50 us", "p99 us", "expanded", "mismatch");
+  run_algorithm("A*", map, queries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      return find_path_a_star(ctx, tiles, map.width, map.height, from, to, 1.f, path, &stats);
+    });
+  run_algorithm("ALT", map, queries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      return find_path_alt(ctx, tiles, map.width, map.height, landmarks, from, to, 1.f, path, &stats);
+    });
+  run_algorithm("JPS", map, queries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      return find_path_jps(ctx, tiles, map.width, map.height, weightedTiles, from, to, 1.f, path, &stats);
+    });
+  run_algorithm("BiA*", map, queries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      return find_path_bidirectional(ctx, tiles, map.width, map.height, from, to, path, &stats);
+    });
+  run_algorithm("A*|BiA*", map, queries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      return find_path_auto(ctx, tiles, map.width, map.height, from, to, path, &stats);
+    });
+  // the queries the switch sends to the bidirectional search, to check that it does win there
+  std::vector<BenchQuery> longQueries;
+  std::vector<float> longCosts;
+  for (size_t i = 0; i < queries.size(); ++i)
+    if (prefer_bidirectional(map.width, map.height, queries[i].from, queries[i].to))
+    {
+      longQueries.push_back(queries[i]);
+      longCosts.push_back(referenceCosts[i]);
+    }
+  if (!longQueries.empty())
+  {
+    run_algorithm("A*long", map, longQueries, longCosts,
+      [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+      {
+        return find_path_a_star(ctx, tiles, map.width, map.height, from, to, 1.f, path, &stats);
+      });
+    run_algorithm("BiA*long", map, longQueries, longCosts,
+      [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+      {
+        return find_path_bidirectional(ctx, tiles, map.width, map.height, from, to, path, &stats);
+      });
+  }
+  // first ARA* solution only, mismatches here are inflated paths
+  AraStarPlanner araPlanner;
+  run_algorithm("ARA*1st", map, queries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      araPlanner.start(tiles, map.width, map.height, from, to);
+      return araPlanner.improve(0.f, path, &stats);
+    });
+  // IDA* revisits too much for thousands of queries, it runs on a prefix with an expansion limit
+  // queries over the limit count as not found and show up as mismatches
+  const std::vector<BenchQuery> idaQueries(queries.begin(),
+                                           queries.begin() + ptrdiff_t(std::min(queries.size(), settings.numIdaQueries)));
+  run_algorithm("IDA*", map, idaQueries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      return find_path_ida_star(tiles, map.width, map.height, from, to, path, &stats,
+                                IdaStarOptions{settings.idaLimit, 0, 0});
+    });
+  run_algorithm("IDA*+TT", map, idaQueries, referenceCosts,
+    [&](Position from, Position to, std::vector<Position> &path, PathStats &stats)
+    {
+      return find_path_ida_star(tiles, map.width, map.height, from, to, path, &stats,
+                                IdaStarOptions{settings.idaLimit, 0, settings.idaTableSize});
+    });
+  return 0;
+}
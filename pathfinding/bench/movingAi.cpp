@@ -0,0 +1,82 @@
+#include "movingAi.h"
+#include "../dungeonUtils.h"
+#include <cstdio>
+#include <cstring>
+
+bool load_movingai_map(const std::string &path, GridMap &out_map)
+{
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file)
+  {
+    printf("can't open map '%s'\n", path.c_str());
+    return false;
+  }
+  // header is "type <name>", "height <h>", "width <w>" and "map" in this order
+  char type[64] = {};
+  int width = 0;
+  int height = 0;
+  char mapTag[16] = {};
+  if (fscanf(file, "type %63s height %d width %d %15s", type, &height, &width, mapTag) != 4 ||
+      strcmp(mapTag, "map") != 0 || width <= 0 || height <= 0)
+  {
+    printf("bad map header in '%s'\n", path.c_str());
+    fclose(file);
+    return false;
+  }
+  out_map.width = size_t(width);
+  out_map.height = size_t(height);
+  out_map.tiles.assign(out_map.width * out_map.height, dungeon::wall);
+  for (size_t y = 0; y < out_map.height; ++y)
+    for (size_t x = 0; x < out_map.width; ++x)
+    {
+      int c = fgetc(file);
+      while (c == '\n' || c == '\r')
+        c = fgetc(file);
+      if (c == EOF)
+      {
+        printf("map '%s' is truncated at row %zu\n", path.c_str(), y);
+        fclose(file);
+        return false;
+      }
+      if (c == '.' || c == 'G' || c == 'S')
+        out_map.tiles[y * out_map.width + x] = dungeon::floor;
+    }
+  fclose(file);
+  return true;
+}
+
+bool load_movingai_scen(const std::string &path, const GridMap &map, std::vector<ScenarioQuery> &out_queries)
+{
+  FILE *file = fopen(path.c_str(), "r");
+  if (!file)
+  {
+    printf("can't open scenario '%s'\n", path.c_str());
+    return false;
+  }
+  out_queries.clear();
+  auto inside = [&](Position p) { return p.x >= 0 && p.y >= 0 && size_t(p.x) < map.width && size_t(p.y) < map.height; };
+  size_t numSkipped = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), file))
+  {
+    if (strncmp(line, "version", 7) == 0)
+      continue;
+    // bucket, map, map width, map height, start x, start y, goal x, goal y, optimal length
+    int bucket, mapWidth, mapHeight;
+    char mapName[512];
+    ScenarioQuery query;
+    if (sscanf(line, "%d %511s %d %d %d %d %d %d %f", &bucket, mapName, &mapWidth, &mapHeight,
+               &query.from.x, &query.from.y, &query.to.x, &query.to.y, &query.optimalLength) != 9)
+      continue;
+    if (size_t(mapWidth) != map.width || size_t(mapHeight) != map.height || !inside(query.from) || !inside(query.to))
+    {
+      numSkipped++;
+      continue;
+    }
+    out_queries.push_back(query);
+  }
+  fclose(file);
+  if (numSkipped > 0)
+    printf("skipped %zu queries of '%s' that don't fit a %zux%zu map\n", numSkipped, path.c_str(), map.width, map.height);
+  return !out_queries.empty();
+}
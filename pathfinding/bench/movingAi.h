@@ -0,0 +1,25 @@
+#pragma once
+#include "../math.h"
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// map in the MovingAI benchmark format (https://movingai.com/benchmarks/formats.html)
+// converted to our tiles, everything except '.', 'G' and 'S' becomes a wall
+struct GridMap
+{
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<char> tiles;
+};
+
+struct ScenarioQuery
+{
+  Position from;
+  Position to;
+  float optimalLength; // as given by the scenario, computed for 8-connected moves
+};
+
+bool load_movingai_map(const std::string &path, GridMap &out_map);
+// lines made for a map of another size or with endpoints outside of the map are skipped
+bool load_movingai_scen(const std::string &path, const GridMap &map, std::vector<ScenarioQuery> &out_queries);
@@ -0,0 +1,141 @@
+#include "bidirectionalAStar.h"
+#include "dungeonUtils.h"
+#include <limits>
+#include <cstdlib>
+
+template<typename T>
+static size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+static float tile_cost(const char *input, size_t idx)
+{
+  return input[idx] == dungeon::water ? 10.f : 1.f;
+}
+
+bool find_path_bidirectional(SearchContext &ctx, const char *input, size_t width, size_t height,
+                             Position from, Position to, std::vector<Position> &out_path,
+                             PathStats *stats, const ExpandCallback &on_expand)
+{
+  out_path.clear();
+  if (stats)
+    stats->nodesExpanded = 0;
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height) ||
+      to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height) ||
+      input[coord_to_idx(to.x, to.y, width)] == dungeon::wall)
+    return false;
+  // forward nodes are tile indices, backward ones are offset by the number of tiles
+  // backward g is the cost from the tile to the goal, i.e. it doesn't include the tile itself
+  const size_t numTiles = width * height;
+  ctx.reset(numTiles * 2);
+  ctx.reverseOpenList.reset(numTiles);
+  IndexedHeap *openLists[2] = {&ctx.openList, &ctx.reverseOpenList};
+  // balanced potentials, forward one is half of (distance to goal - distance to start), backward is the negation
+  // both are consistent, so each side is Dijkstra over non-negative reduced costs and the sides can be compared
+  auto potential = [&](Position p, size_t dir)
+  {
+    const float forward = (heuristic(p, to) - heuristic(p, from)) * 0.5f;
+    return dir == 0 ? forward : -forward;
+  };
+
+  const size_t fromIdx = coord_to_idx(from.x, from.y, width);
+  const size_t toIdx = coord_to_idx(to.x, to.y, width);
+  ctx.set_g(fromIdx, 0.f, invalid_node);
+  ctx.set_state(fromIdx, NS_OPEN);
+  ctx.openList.push(fromIdx, potential(from, 0));
+  ctx.set_g(numTiles + toIdx, 0.f, invalid_node);
+  ctx.set_state(numTiles + toIdx, NS_OPEN);
+  ctx.reverseOpenList.push(toIdx, potential(to, 1));
+
+  float bestCost = std::numeric_limits<float>::max();
+  size_t meetIdx = fromIdx == toIdx ? fromIdx : invalid_node;
+  if (meetIdx != invalid_node)
+    bestCost = 0.f;
+  size_t nodesExpanded = 0;
+  while (!ctx.openList.empty() && !ctx.reverseOpenList.empty())
+  {
+    // potentials cancel out along any path, so a path through the frontiers costs at least the sum of their keys
+    if (ctx.openList.top_key() + ctx.reverseOpenList.top_key() >= bestCost)
+      break;
+    // expand the smaller frontier
+    const size_t dir = ctx.openList.size() <= ctx.reverseOpenList.size() ? 0 : 1;
+    const size_t offset = dir * numTiles;
+    const size_t otherOffset = (1 - dir) * numTiles;
+    const size_t idx = openLists[dir]->pop();
+    ctx.set_state(offset + idx, NS_CLOSED);
+    ++nodesExpanded;
+    const float curG = ctx.get_g(offset + idx);
+    const Position curPos{int(idx % width), int(idx / width)};
+    if (on_expand)
+      on_expand(curPos, curG);
+    // moving backwards from idx to a neighbour is the forward move onto idx
+    const float backwardCost = dir == 1 ? tile_cost(input, idx) : 0.f;
+    auto checkNeighbour = [&](Position p)
+    {
+      // out of bounds
+      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+        return;
+      const size_t nidx = coord_to_idx(p.x, p.y, width);
+      // not empty
+      if (input[nidx] == dungeon::wall)
+        return;
+      const uint8_t nstate = ctx.get_state(offset + nidx);
+      if (nstate == NS_CLOSED)
+        return;
+      const float gScore = curG + (dir == 0 ? tile_cost(input, nidx) : backwardCost);
+      if (gScore >= ctx.get_g(offset + nidx))
+        return;
+      ctx.set_g(offset + nidx, gScore, offset + idx);
+      const float otherG = ctx.get_g(otherOffset + nidx);
+      if (otherG != std::numeric_limits<float>::max() && gScore + otherG < bestCost)
+      {
+        bestCost = gScore + otherG;
+        meetIdx = nidx;
+      }
+      const float fScore = gScore + potential(p, dir);
+      if (nstate == NS_OPEN)
+        openLists[dir]->decrease_key(nidx, fScore);
+      else
+      {
+        ctx.set_state(offset + nidx, NS_OPEN);
+        openLists[dir]->push(nidx, fScore);
+      }
+    };
+    checkNeighbour({curPos.x + 1, curPos.y + 0});
+    checkNeighbour({curPos.x - 1, curPos.y + 0});
+    checkNeighbour({curPos.x + 0, curPos.y + 1});
+    checkNeighbour({curPos.x + 0, curPos.y - 1});
+  }
+  if (stats)
+    stats->nodesExpanded = nodesExpanded;
+  if (meetIdx == invalid_node)
+    return false;
+
+  // forward half from the start to the meeting tile, then backward links to the goal
+  size_t len = 0;
+  for (size_t idx = meetIdx; idx != invalid_node; idx = ctx.get_prev(idx))
+    ++len;
+  out_path.resize(len);
+  for (size_t idx = meetIdx; idx != invalid_node; idx = ctx.get_prev(idx))
+    out_path[--len] = Position{int(idx % width), int(idx / width)};
+  for (size_t idx = ctx.get_prev(numTiles + meetIdx); idx != invalid_node; idx = ctx.get_prev(idx))
+    out_path.push_back(Position{int((idx - numTiles) % width), int((idx - numTiles) / width)});
+  return true;
+}
+
+bool prefer_bidirectional(size_t width, size_t height, Position from, Position to)
+{
+  // measured crossover on 512x512 drunk maps is at about 4/5 of the half perimeter,
+  // closer queries pay more for the second heap than they save in expansions
+  return size_t(abs(from.x - to.x) + abs(from.y - to.y)) * 5 > (width + height) * 4;
+}
+
+bool find_path_auto(SearchContext &ctx, const char *input, size_t width, size_t height,
+                    Position from, Position to, std::vector<Position> &out_path,
+                    PathStats *stats, const ExpandCallback &on_expand)
+{
+  if (prefer_bidirectional(width, height, from, to))
+    return find_path_bidirectional(ctx, input, width, height, from, to, out_path, stats, on_expand);
+  return find_path_a_star(ctx, input, width, height, from, to, 1.f, out_path, stats, on_expand);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "pathfinder.h"
+
+// A* from both ends at once with averaged front-to-end heuristics, stops when frontiers can't beat the best meeting
+// path costs are the same as for find_path_a_star, search storage is the same context with two halves
+bool find_path_bidirectional(SearchContext &ctx, const char *input, size_t width, size_t height,
+                             Position from, Position to, std::vector<Position> &out_path,
+                             PathStats *stats = nullptr, const ExpandCallback &on_expand = {});
+
+// only queries spanning most of the map, close to corner to corner, are where the second frontier pays off
+bool prefer_bidirectional(size_t width, size_t height, Position from, Position to);
+
+// picks one of the two searches with prefer_bidirectional
+bool find_path_auto(SearchContext &ctx, const char *input, size_t width, size_t height,
+                    Position from, Position to, std::vector<Position> &out_path,
+                    PathStats *stats = nullptr, const ExpandCallback &on_expand = {});
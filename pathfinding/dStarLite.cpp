@@ -0,0 +1,202 @@
+#include "dStarLite.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+
+template<typename T>
+static size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+static constexpr float infinity = std::numeric_limits<float>::infinity();
+
+template<typename Callable>
+static void for_each_neighbour(size_t idx, size_t width, size_t height, Callable fn)
+{
+  const size_t x = idx % width;
+  const size_t y = idx / width;
+  if (x + 1 < width)
+    fn(idx + 1);
+  if (x > 0)
+    fn(idx - 1);
+  if (y + 1 < height)
+    fn(idx + width);
+  if (y > 0)
+    fn(idx - width);
+}
+
+// cost of stepping onto the tile, same as in find_path_a_star
+float DStarLitePlanner::tile_cost(size_t idx) const
+{
+  return input[idx] == dungeon::wall ? infinity : input[idx] == dungeon::water ? 10.f : 1.f;
+}
+
+// manhattan distance to the start, consistent as every move costs at least 1
+float DStarLitePlanner::estimate(size_t idx) const
+{
+  return float(abs(int(idx % width) - start.x) + abs(int(idx / width) - start.y));
+}
+
+DStarLitePlanner::Key DStarLitePlanner::calculate_key(size_t idx) const
+{
+  const float minG = std::min(g[idx], rhs[idx]);
+  return Key{minG + estimate(idx) + km, minG};
+}
+
+float DStarLitePlanner::best_successor(size_t idx, size_t *out_idx) const
+{
+  float best = infinity;
+  if (input[idx] == dungeon::wall)
+    return best;
+  for_each_neighbour(idx, width, height, [&](size_t nidx)
+  {
+    const float score = tile_cost(nidx) + g[nidx];
+    if (score < best)
+    {
+      best = score;
+      if (out_idx)
+        *out_idx = nidx;
+    }
+  });
+  return best;
+}
+
+void DStarLitePlanner::update_vertex(size_t idx)
+{
+  const bool consistent = g[idx] == rhs[idx];
+  if (!consistent && queued[idx])
+    openList.update(idx, calculate_key(idx));
+  else if (!consistent)
+  {
+    openList.push(idx, calculate_key(idx));
+    queued[idx] = 1;
+  }
+  else if (queued[idx])
+  {
+    openList.remove(idx);
+    queued[idx] = 0;
+  }
+}
+
+void DStarLitePlanner::init(const char *grid, size_t grid_width, size_t grid_height, Position start_pos, Position goal_pos)
+{
+  input = grid;
+  width = grid_width;
+  height = grid_height;
+  start = lastStart = start_pos;
+  goal = goal_pos;
+  km = 0.f;
+  g.assign(width * height, infinity);
+  rhs.assign(width * height, infinity);
+  queued.assign(width * height, 0);
+  openList.reset(width * height);
+  if (goal.x < 0 || goal.y < 0 || goal.x >= int(width) || goal.y >= int(height))
+    return;
+  const size_t goalIdx = coord_to_idx(goal.x, goal.y, width);
+  rhs[goalIdx] = 0.f;
+  update_vertex(goalIdx);
+}
+
+void DStarLitePlanner::notify_tile_changed(Position pos)
+{
+  if (pos.x < 0 || pos.y < 0 || pos.x >= int(width) || pos.y >= int(height))
+    return;
+  // cost of entering the tile changes edges from all neighbours, and a tile turned into a wall can't be left
+  const size_t idx = coord_to_idx(pos.x, pos.y, width);
+  const size_t goalIdx = coord_to_idx(goal.x, goal.y, width);
+  auto repair = [&](size_t nidx)
+  {
+    if (nidx != goalIdx)
+      rhs[nidx] = best_successor(nidx, nullptr);
+    update_vertex(nidx);
+  };
+  repair(idx);
+  for_each_neighbour(idx, width, height, repair);
+}
+
+void DStarLitePlanner::move_start(Position start_pos)
+{
+  start = start_pos;
+  km += float(abs(start.x - lastStart.x) + abs(start.y - lastStart.y));
+  lastStart = start;
+}
+
+bool DStarLitePlanner::compute_path(std::vector<Position> &out_path, PathStats *stats, const ExpandCallback &on_expand)
+{
+  out_path.clear();
+  if (stats)
+    stats->nodesExpanded = 0;
+  if (!input || start.x < 0 || start.y < 0 || start.x >= int(width) || start.y >= int(height) ||
+      goal.x < 0 || goal.y < 0 || goal.x >= int(width) || goal.y >= int(height))
+    return false;
+  const size_t startIdx = coord_to_idx(start.x, start.y, width);
+  const size_t goalIdx = coord_to_idx(goal.x, goal.y, width);
+
+  size_t nodesExpanded = 0;
+  while (!openList.empty() && (openList.top_key() < calculate_key(startIdx) || rhs[startIdx] > g[startIdx]))
+  {
+    const size_t idx = openList.top();
+    const Key oldKey = openList.top_key();
+    const Key newKey = calculate_key(idx);
+    if (oldKey < newKey)
+    {
+      // key is stale since the start has moved
+      openList.update(idx, newKey);
+      continue;
+    }
+    ++nodesExpanded;
+    if (on_expand)
+      on_expand(Position{int(idx % width), int(idx / width)}, std::min(g[idx], rhs[idx]));
+    if (g[idx] > rhs[idx])
+    {
+      // overconsistent, settle it and relax predecessors
+      g[idx] = rhs[idx];
+      openList.remove(idx);
+      queued[idx] = 0;
+      const float enterCost = tile_cost(idx);
+      for_each_neighbour(idx, width, height, [&](size_t nidx)
+      {
+        if (nidx != goalIdx && input[nidx] != dungeon::wall)
+          rhs[nidx] = std::min(rhs[nidx], enterCost + g[idx]);
+        update_vertex(nidx);
+      });
+    }
+    else
+    {
+      // underconsistent, invalidate it and everything which relied on it
+      const float oldG = g[idx];
+      g[idx] = infinity;
+      const float enterCost = tile_cost(idx);
+      auto repair = [&](size_t nidx)
+      {
+        if (nidx != goalIdx && (nidx == idx || rhs[nidx] == enterCost + oldG))
+          rhs[nidx] = best_successor(nidx, nullptr);
+        update_vertex(nidx);
+      };
+      repair(idx);
+      for_each_neighbour(idx, width, height, repair);
+    }
+  }
+  if (stats)
+    stats->nodesExpanded = nodesExpanded;
+
+  if (rhs[startIdx] == infinity)
+    return false;
+  // follow the cheapest successors, the number of steps is bound to guard against ties forming a loop
+  size_t idx = startIdx;
+  out_path.push_back(start);
+  while (idx != goalIdx)
+  {
+    size_t next = idx;
+    if (best_successor(idx, &next) == infinity || out_path.size() > width * height)
+    {
+      out_path.clear();
+      return false;
+    }
+    idx = next;
+    out_path.push_back(Position{int(idx % width), int(idx / width)});
+  }
+  return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "pathfinder.h"
+#include "indexedHeap.h"
+#include <vector>
+#include <cstddef>
+
+// D* Lite, searches backwards from the goal and keeps its state between calls,
+// so after tile edits or a start move only the affected part of the search is repaired
+// the goal is fixed, a new goal needs init
+class DStarLitePlanner
+{
+public:
+  struct Key
+  {
+    float k1;
+    float k2;
+    bool operator<(const Key &rhs) const { return k1 < rhs.k1 || (k1 == rhs.k1 && k2 < rhs.k2); }
+  };
+
+  // input is read on every call, it has to stay alive and be edited in place
+  void init(const char *grid, size_t grid_width, size_t grid_height, Position start_pos, Position goal_pos);
+  // tile at pos was edited in input
+  void notify_tile_changed(Position pos);
+  // agent moved, the heuristic is relative to the start so queued keys get an offset instead of a rebuild
+  void move_start(Position start_pos);
+  // repairs the search if something has changed and writes the current path, returns false if there's none
+  bool compute_path(std::vector<Position> &out_path, PathStats *stats = nullptr, const ExpandCallback &on_expand = {});
+
+  bool is_initialized() const { return input != nullptr; }
+  Position get_start() const { return start; }
+  Position get_goal() const { return goal; }
+
+private:
+  const char *input = nullptr;
+  size_t width = 0;
+  size_t height = 0;
+  Position start;
+  Position goal;
+  Position lastStart;
+  float km = 0.f;
+  std::vector<float> g;
+  std::vector<float> rhs;
+  std::vector<char> queued;
+  BasicIndexedHeap<Key> openList;
+
+  float tile_cost(size_t idx) const;
+  float estimate(size_t idx) const;
+  Key calculate_key(size_t idx) const;
+  float best_successor(size_t idx, size_t *out_idx) const;
+  void update_vertex(size_t idx);
+};
@@ -7,21 +7,33 @@
 #include <functional> // std::bind
 #include "math.h"
 #include <limits>
-#include "raylib.h"
+#include <vector>
 
-Position gen_random_dir()
+static unsigned gen_time_seed()
+{
+  return unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
+}
+
+Position gen_random_dir(std::default_random_engine &rng)
 {
   constexpr Position dirs[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
-  return dirs[GetRandomValue(0, 3)];
+  return dirs[std::uniform_int_distribution<int>(0, 3)(rng)];
 }
 
 void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_excavations)
+{
+  gen_drunk_dungeon(tiles, w, h, num_iter, max_excavations, gen_time_seed());
+  for (size_t y = 0; y < h; ++y)
+    printf("%.*s\n", int(w), tiles + y * w);
+}
+
+void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_excavations, const unsigned seed)
 {
   memset(tiles, dungeon::wall, w * h);
 
   // generator
-  unsigned seed = unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
   std::default_random_engine seedGenerator(seed);
   std::default_random_engine widthGenerator(seedGenerator());
   std::default_random_engine heightGenerator(seedGenerator());
@@ -88,33 +100,39 @@ void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
       tiles[size_t(pos.y) * w + size_t(pos.x)] = dungeon::floor;
     }
   }
-
-  for (size_t y = 0; y < h; ++y)
-    printf("%.*s\n", int(w), tiles + y * w);
 }
 
 void spill_drunk_water(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_spills)
 {
-  for (size_t iter = 0; iter < num_iter; ++iter)
+  std::default_random_engine rng(gen_time_seed());
+  // starts are picked from floor as it was before spilling, a start already under water just spills further on
+  std::vector<size_t> floorTiles;
+  for (size_t idx = 0; idx < w * h; ++idx)
+    if (tiles[idx] == dungeon::floor)
+      floorTiles.push_back(idx);
+  size_t numFloorLeft = floorTiles.size();
+  for (size_t iter = 0; iter < num_iter && numFloorLeft > 0; ++iter)
   {
-    Position p = dungeon::find_walkable_tile(tiles, w, h);
+    const size_t startIdx = floorTiles[std::uniform_int_distribution<size_t>(0, floorTiles.size() - 1)(rng)];
+    Position p{int(startIdx % w), int(startIdx / w)};
     // select random point on map
     size_t x = size_t(p.x);
     size_t y = size_t(p.y);
     size_t numSpills = 0;
-    while (numSpills < max_spills)
+    while (numSpills < max_spills && numFloorLeft > 0)
     {
       if (tiles[y * w + x] == dungeon::floor)
       {
         numSpills++;
+        numFloorLeft--;
         tiles[y * w + x] = dungeon::water;
       }
       // choose random dir
       bool validDir = false;
       while (!validDir)
       {
-        const Position dir = gen_random_dir(); // 0 - right, 1 - up, 2 - left, 3 - down
+        const Position dir = gen_random_dir(rng); // 0 - right, 1 - up, 2 - left, 3 - down
         int newX = std::min(std::max(int(x) + dir.x, 1), int(w) - 2);
         int newY = std::min(std::max(int(y) + dir.y, 1), int(h) - 2);
         if (tiles[size_t(newY) * w + size_t(newX)] != dungeon::wall)
@@ -3,6 +3,9 @@
 
 void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_excavations);
+// same as above, but the map depends only on the seed and isn't printed
+void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_excavations, const unsigned seed);
 
 void spill_drunk_water(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_spills);
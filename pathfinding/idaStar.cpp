@@ -0,0 +1,158 @@
+#include "idaStar.h"
+#include "dungeonUtils.h"
+#include <float.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+template<typename T>
+static size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+namespace
+{
+  struct StackFrame
+  {
+    uint32_t idx;
+    float g;
+    uint8_t nextDir; // next neighbour to try, 4 when all are done
+  };
+
+  // best g seen per tile, entries are overwritten on collision so it only ever loses information
+  class TranspositionTable
+  {
+    struct Entry
+    {
+      uint32_t idx = UINT32_MAX;
+      uint32_t iteration = 0;
+      float g = FLT_MAX;
+    };
+    std::vector<Entry> entries;
+
+  public:
+    explicit TranspositionTable(size_t size) : entries(size) {}
+
+    bool enabled() const { return !entries.empty(); }
+
+    // returns false if the tile was already reached with a better g, or with the same g in this iteration
+    // otherwise remembers the new g
+    bool try_visit(uint32_t idx, float g, uint32_t iteration)
+    {
+      Entry &entry = entries[size_t(idx) % entries.size()];
+      if (entry.idx == idx && (g > entry.g || (g == entry.g && entry.iteration == iteration)))
+        return false;
+      entry = Entry{idx, iteration, g};
+      return true;
+    }
+  };
+}
+
+bool find_path_ida_star(const char *input, size_t width, size_t height, Position from, Position to,
+                        std::vector<Position> &out_path, PathStats *stats, const IdaStarOptions &options)
+{
+  out_path.clear();
+  if (stats)
+    stats->nodesExpanded = 0;
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height) ||
+      to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height) ||
+      input[coord_to_idx(from.x, from.y, width)] == dungeon::wall)
+    return false;
+
+  const size_t numTiles = width * height;
+  const uint32_t fromIdx = uint32_t(coord_to_idx(from.x, from.y, width));
+  const uint32_t toIdx = uint32_t(coord_to_idx(to.x, to.y, width));
+  // manhattan distance is admissible for 4-connected moves and keeps f integer on uniform maps,
+  // with euclidean distance almost every iteration raises the bound by a tiny fraction
+  auto estimate = [&](uint32_t idx) { return float(abs(int(idx % width) - to.x) + abs(int(idx / width) - to.y)); };
+
+  std::vector<StackFrame> stack;
+  const size_t maxDepth = options.maxDepth > 0 ? options.maxDepth : numTiles;
+  stack.reserve(maxDepth);
+  std::vector<uint64_t> onPath((numTiles + 63) / 64, 0);
+  auto setOnPath = [&](uint32_t idx, bool value)
+  {
+    if (value)
+      onPath[idx / 64] |= uint64_t(1) << (idx % 64);
+    else
+      onPath[idx / 64] &= ~(uint64_t(1) << (idx % 64));
+  };
+  auto isOnPath = [&](uint32_t idx) { return (onPath[idx / 64] >> (idx % 64)) & 1; };
+  TranspositionTable table(options.transpositionSize);
+
+  size_t nodesExpanded = 0;
+  bool found = false;
+  bool aborted = false;
+  float bound = estimate(fromIdx);
+  for (uint32_t iteration = 1; !found && !aborted; ++iteration)
+  {
+    float nextBound = FLT_MAX;
+    stack.push_back({fromIdx, 0.f, 0});
+    setOnPath(fromIdx, true);
+    if (table.enabled())
+      table.try_visit(fromIdx, 0.f, iteration);
+    found = fromIdx == toIdx;
+    while (!stack.empty() && !found)
+    {
+      StackFrame &frame = stack.back();
+      if (frame.nextDir == 4)
+      {
+        setOnPath(frame.idx, false);
+        stack.pop_back();
+        continue;
+      }
+      const int x = int(frame.idx % width);
+      const int y = int(frame.idx / width);
+      constexpr int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+      const int nx = x + dirs[frame.nextDir][0];
+      const int ny = y + dirs[frame.nextDir][1];
+      ++frame.nextDir;
+      // out of bounds
+      if (nx < 0 || ny < 0 || nx >= int(width) || ny >= int(height))
+        continue;
+      const uint32_t nidx = uint32_t(coord_to_idx(nx, ny, width));
+      // not empty or a cycle
+      if (input[nidx] == dungeon::wall || isOnPath(nidx))
+        continue;
+      const float g = frame.g + (input[nidx] == dungeon::water ? 10.f : 1.f);
+      const float f = g + estimate(nidx);
+      if (f > bound)
+      {
+        nextBound = std::min(nextBound, f);
+        continue;
+      }
+      if (table.enabled() && !table.try_visit(nidx, g, iteration))
+        continue;
+      if (stack.size() == maxDepth)
+        continue; // too deep for the stack, this branch is lost
+      if (options.maxExpansions > 0 && nodesExpanded >= options.maxExpansions)
+      {
+        aborted = true;
+        break;
+      }
+      ++nodesExpanded;
+      stack.push_back({nidx, g, 0}); // frame reference is invalid from here
+      setOnPath(nidx, true);
+      found = nidx == toIdx;
+    }
+    if (found)
+      break;
+    for (const StackFrame &frame : stack)
+      setOnPath(frame.idx, false);
+    stack.clear();
+    if (nextBound == FLT_MAX)
+      break;
+    bound = nextBound;
+  }
+
+  if (found)
+  {
+    out_path.resize(stack.size());
+    for (size_t i = 0; i < stack.size(); ++i)
+      out_path[i] = Position{int(stack[i].idx % width), int(stack[i].idx / width)};
+  }
+  if (stats)
+    stats->nodesExpanded = nodesExpanded;
+  return found;
+}
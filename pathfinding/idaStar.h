@@ -0,0 +1,15 @@
+#pragma once
+#include "pathfinder.h"
+
+struct IdaStarOptions
+{
+  size_t maxExpansions = 0; // gives up and returns false after that many nodes, 0 means no limit
+  size_t maxDepth = 0; // capacity of the search stack, 0 means number of tiles which always fits a path
+  size_t transpositionSize = 0; // entries in the table of best g per tile, 0 disables it
+};
+
+// iterative deepening A* with an explicit stack, memory is bound by the options instead of the open list
+// transposition table prunes tiles reached again with a worse g, which cuts most of the revisits on grids
+bool find_path_ida_star(const char *input, size_t width, size_t height, Position from, Position to,
+                        std::vector<Position> &out_path, PathStats *stats = nullptr,
+                        const IdaStarOptions &options = {});
@@ -0,0 +1,130 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// binary min-heap over node indices with decrease-key support
+// nodes are tile indices in [0, capacity), keys only need operator<
+template<typename Key>
+class BasicIndexedHeap
+{
+  struct Entry
+  {
+    Key key;
+    size_t node;
+  };
+  std::vector<Entry> heap;
+  std::vector<size_t> heapIdx; // node -> position in heap, valid only while node is in heap
+
+  void place(size_t i, const Entry &e)
+  {
+    heap[i] = e;
+    heapIdx[e.node] = i;
+  }
+
+  void sift_up(size_t i)
+  {
+    const Entry e = heap[i];
+    while (i > 0)
+    {
+      const size_t parent = (i - 1) / 2;
+      if (!(e.key < heap[parent].key))
+        break;
+      place(i, heap[parent]);
+      i = parent;
+    }
+    place(i, e);
+  }
+
+  void sift_down(size_t i)
+  {
+    const Entry e = heap[i];
+    const size_t count = heap.size();
+    while (true)
+    {
+      size_t child = i * 2 + 1;
+      if (child >= count)
+        break;
+      if (child + 1 < count && heap[child + 1].key < heap[child].key)
+        ++child;
+      if (!(heap[child].key < e.key))
+        break;
+      place(i, heap[child]);
+      i = child;
+    }
+    place(i, e);
+  }
+
+public:
+  void reset(size_t capacity)
+  {
+    heap.clear();
+    if (heapIdx.size() < capacity)
+      heapIdx.resize(capacity);
+  }
+
+  bool empty() const { return heap.empty(); }
+  size_t size() const { return heap.size(); }
+  const Key &top_key() const { return heap.front().key; }
+  size_t top() const { return heap.front().node; }
+
+  void push(size_t node, const Key &key)
+  {
+    heap.push_back({key, node});
+    sift_up(heap.size() - 1);
+  }
+
+  // caller guarantees node is in the heap and key is not greater than the current one
+  void decrease_key(size_t node, const Key &key)
+  {
+    const size_t i = heapIdx[node];
+    heap[i].key = key;
+    sift_up(i);
+  }
+
+  // caller guarantees node is in the heap, key may go either way
+  void update(size_t node, const Key &key)
+  {
+    const size_t i = heapIdx[node];
+    heap[i].key = key;
+    sift_up(i);
+    sift_down(heapIdx[node]);
+  }
+
+  // caller guarantees node is in the heap
+  void remove(size_t node)
+  {
+    const size_t i = heapIdx[node];
+    const Entry last = heap.back();
+    heap.pop_back();
+    if (i == heap.size())
+      return;
+    place(i, last);
+    sift_up(i);
+    sift_down(heapIdx[last.node]);
+  }
+
+  // recomputes every key with key_of(node) and restores the heap order in linear time
+  template<typename KeyOf>
+  void rekey(KeyOf key_of)
+  {
+    for (Entry &e : heap)
+      e.key = key_of(e.node);
+    for (size_t i = heap.size() / 2; i-- > 0;)
+      sift_down(i);
+  }
+
+  size_t pop()
+  {
+    const size_t node = heap.front().node;
+    const Entry last = heap.back();
+    heap.pop_back();
+    if (!heap.empty())
+    {
+      heap.front() = last;
+      sift_down(0);
+    }
+    return node;
+  }
+};
+
+using IndexedHeap = BasicIndexedHeap<float>;
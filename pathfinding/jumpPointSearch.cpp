@@ -0,0 +1,198 @@
+#include "jumpPointSearch.h"
+#include "dungeonUtils.h"
+#include <cstring>
+#include <cstdlib>
+
+// Canonical paths here are the ones which turn from vertical to horizontal movement only when forced to,
+// i.e. when the side tile behind was a wall. Any shortest path can be brought to this form by swapping
+// "vertical, horizontal" pairs of moves, so pruning everything else keeps the search optimal.
+// Horizontal moves may turn vertical anywhere, so horizontal jumps stop where a vertical one finds something.
+
+template<typename T>
+static size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+namespace
+{
+  struct JumpGrid
+  {
+    const char *input;
+    int width;
+    int height;
+    Position to;
+
+    bool walkable(int x, int y) const
+    {
+      return x >= 0 && y >= 0 && x < width && y < height &&
+             input[coord_to_idx(x, y, size_t(width))] != dungeon::wall;
+    }
+
+    bool forced_horizontal(Position p, int dx, int dy) const
+    {
+      return walkable(p.x + dx, p.y) && !walkable(p.x + dx, p.y - dy);
+    }
+
+    bool jump_vertical(Position &p, int dy) const
+    {
+      while (true)
+      {
+        p.y += dy;
+        if (!walkable(p.x, p.y))
+          return false;
+        if (p == to || forced_horizontal(p, 1, dy) || forced_horizontal(p, -1, dy))
+          return true;
+      }
+    }
+
+    bool jump_horizontal(Position &p, int dx) const
+    {
+      while (true)
+      {
+        p.x += dx;
+        if (!walkable(p.x, p.y))
+          return false;
+        if (p == to)
+          return true;
+        Position up = p;
+        Position down = p;
+        if (jump_vertical(up, -1) || jump_vertical(down, 1))
+          return true;
+      }
+    }
+  };
+}
+
+bool has_weighted_tiles(const char *input, size_t width, size_t height)
+{
+  return memchr(input, dungeon::water, width * height) != nullptr;
+}
+
+static void reconstruct_jump_path(const SearchContext &ctx, size_t to_idx, size_t width,
+                                  std::vector<Position> &out_path)
+{
+  auto toPos = [&](size_t idx) { return Position{int(idx % width), int(idx / width)}; };
+  size_t len = 1;
+  for (size_t idx = to_idx; ctx.get_prev(idx) != invalid_node; idx = ctx.get_prev(idx))
+  {
+    const Position delta = toPos(idx) - toPos(ctx.get_prev(idx));
+    len += size_t(abs(delta.x) + abs(delta.y));
+  }
+  out_path.resize(len);
+  out_path[--len] = toPos(to_idx);
+  for (size_t idx = to_idx; ctx.get_prev(idx) != invalid_node; idx = ctx.get_prev(idx))
+  {
+    // jump points are connected with straight lines, fill them in
+    Position p = toPos(idx);
+    const Position prev = toPos(ctx.get_prev(idx));
+    const Position step{prev.x > p.x ? 1 : prev.x < p.x ? -1 : 0, prev.y > p.y ? 1 : prev.y < p.y ? -1 : 0};
+    while (p != prev)
+    {
+      p = Position{p.x + step.x, p.y + step.y};
+      out_path[--len] = p;
+    }
+  }
+}
+
+bool find_path_jps(SearchContext &ctx, const char *input, size_t width, size_t height, bool weighted_tiles,
+                   Position from, Position to, float weight, std::vector<Position> &out_path,
+                   PathStats *stats, const ExpandCallback &on_expand)
+{
+  if (weighted_tiles)
+    return find_path_a_star(ctx, input, width, height, from, to, weight, out_path, stats, on_expand);
+
+  out_path.clear();
+  const JumpGrid grid{input, int(width), int(height), to};
+  if (!grid.walkable(from.x, from.y))
+    return false;
+  ctx.reset(width * height);
+  IndexedHeap &openList = ctx.openList;
+
+  const size_t fromIdx = coord_to_idx(from.x, from.y, width);
+  ctx.set_g(fromIdx, 0.f, invalid_node);
+  ctx.set_state(fromIdx, NS_OPEN);
+  openList.push(fromIdx, weight * heuristic(from, to));
+
+  size_t nodesExpanded = 0;
+  bool found = false;
+  while (!openList.empty())
+  {
+    const size_t idx = openList.pop();
+    ctx.set_state(idx, NS_CLOSED);
+    const Position curPos{int(idx % width), int(idx / width)};
+    if (curPos == to)
+    {
+      reconstruct_jump_path(ctx, idx, width, out_path);
+      found = true;
+      break;
+    }
+    ++nodesExpanded;
+    const float curG = ctx.get_g(idx);
+    if (on_expand)
+      on_expand(curPos, curG);
+
+    auto addJumpPoint = [&](Position p)
+    {
+      const size_t nidx = coord_to_idx(p.x, p.y, width);
+      const uint8_t nstate = ctx.get_state(nidx);
+      if (nstate == NS_CLOSED)
+        return;
+      const float gScore = curG + float(abs(p.x - curPos.x) + abs(p.y - curPos.y));
+      if (gScore >= ctx.get_g(nidx))
+        return;
+      ctx.set_g(nidx, gScore, idx);
+      const float fScore = gScore + weight * heuristic(p, to);
+      if (nstate == NS_OPEN)
+        openList.decrease_key(nidx, fScore);
+      else
+      {
+        ctx.set_state(nidx, NS_OPEN);
+        openList.push(nidx, fScore);
+      }
+    };
+    auto jumpHorizontal = [&](int dx)
+    {
+      Position p = curPos;
+      if (grid.jump_horizontal(p, dx))
+        addJumpPoint(p);
+    };
+    auto jumpVertical = [&](int dy)
+    {
+      Position p = curPos;
+      if (grid.jump_vertical(p, dy))
+        addJumpPoint(p);
+    };
+
+    const size_t prevIdx = ctx.get_prev(idx);
+    if (prevIdx == invalid_node)
+    {
+      jumpHorizontal(1);
+      jumpHorizontal(-1);
+      jumpVertical(1);
+      jumpVertical(-1);
+      continue;
+    }
+    const Position prevPos{int(prevIdx % width), int(prevIdx / width)};
+    if (prevPos.y == curPos.y)
+    {
+      // horizontal move continues and may turn both ways
+      jumpHorizontal(curPos.x > prevPos.x ? 1 : -1);
+      jumpVertical(1);
+      jumpVertical(-1);
+    }
+    else
+    {
+      // vertical move continues and turns only where it's forced to
+      const int dy = curPos.y > prevPos.y ? 1 : -1;
+      jumpVertical(dy);
+      if (grid.forced_horizontal(curPos, 1, dy))
+        jumpHorizontal(1);
+      if (grid.forced_horizontal(curPos, -1, dy))
+        jumpHorizontal(-1);
+    }
+  }
+  if (stats)
+    stats->nodesExpanded = nodesExpanded;
+  return found;
+}
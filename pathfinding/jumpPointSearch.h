@@ -0,0 +1,12 @@
+#pragma once
+#include "pathfinder.h"
+
+// jump point search for 4-connected grids with uniform move cost
+// maps with water tiles are not uniform, for them it falls back to find_path_a_star
+// weighted_tiles is has_weighted_tiles of the map, kept by the caller and updated on map edits
+bool find_path_jps(SearchContext &ctx, const char *input, size_t width, size_t height, bool weighted_tiles,
+                   Position from, Position to, float weight, std::vector<Position> &out_path,
+                   PathStats *stats = nullptr, const ExpandCallback &on_expand = {});
+
+// scans the whole map, so it's meant to run once per map edit rather than per query
+bool has_weighted_tiles(const char *input, size_t width, size_t height);
@@ -0,0 +1,95 @@
+#include "landmarks.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cstdlib>
+
+static void bfs_field(const char *input, size_t width, size_t height, size_t from_idx, uint16_t *dist,
+                      std::vector<size_t> &queue)
+{
+  std::fill(dist, dist + width * height, landmark_unreachable);
+  queue.clear();
+  queue.push_back(from_idx);
+  dist[from_idx] = 0;
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const size_t idx = queue[head];
+    const size_t x = idx % width;
+    const size_t y = idx / width;
+    const uint16_t nextDist = uint16_t(std::min<int>(dist[idx] + 1, landmark_unreachable - 1));
+    auto checkNeighbour = [&](size_t nidx)
+    {
+      if (input[nidx] == dungeon::wall || dist[nidx] != landmark_unreachable)
+        return;
+      dist[nidx] = nextDist;
+      queue.push_back(nidx);
+    };
+    if (x + 1 < width)
+      checkNeighbour(idx + 1);
+    if (x > 0)
+      checkNeighbour(idx - 1);
+    if (y + 1 < height)
+      checkNeighbour(idx + width);
+    if (y > 0)
+      checkNeighbour(idx - width);
+  }
+}
+
+LandmarkTable build_landmarks(const char *input, size_t width, size_t height, size_t num_landmarks)
+{
+  LandmarkTable table;
+  table.width = width;
+  table.height = height;
+  const size_t numTiles = width * height;
+  const size_t firstFloor = size_t(std::find_if(input, input + numTiles,
+                                                [](char c) { return c != dungeon::wall; }) - input);
+  if (firstFloor == numTiles || num_landmarks == 0)
+    return table;
+
+  // the first landmark is the farthest tile from an arbitrary one, every next is the farthest from all chosen,
+  // tiles not reached by any landmark yet count as infinitely far so every area gets covered
+  std::vector<size_t> queue;
+  std::vector<uint16_t> minDist(numTiles, landmark_unreachable);
+  std::vector<uint16_t> scratch(numTiles);
+  bfs_field(input, width, height, firstFloor, scratch.data(), queue);
+  size_t nextLandmark = queue.back();
+
+  table.dist.resize(num_landmarks * numTiles);
+  for (size_t i = 0; i < num_landmarks; ++i)
+  {
+    uint16_t *field = table.dist.data() + i * numTiles;
+    bfs_field(input, width, height, nextLandmark, field, queue);
+    table.landmarks.push_back(Position{int(nextLandmark % width), int(nextLandmark / width)});
+    size_t best = numTiles;
+    for (size_t idx = 0; idx < numTiles; ++idx)
+    {
+      if (input[idx] == dungeon::wall)
+        continue;
+      minDist[idx] = std::min(minDist[idx], field[idx]);
+      if (best == numTiles || minDist[idx] > minDist[best])
+        best = idx;
+    }
+    if (minDist[best] == 0)
+    {
+      // every walkable tile is a landmark already
+      table.dist.resize(table.landmarks.size() * numTiles);
+      break;
+    }
+    nextLandmark = best;
+  }
+  return table;
+}
+
+float landmark_heuristic(const LandmarkTable &table, size_t from_idx, size_t to_idx)
+{
+  const size_t numTiles = table.width * table.height;
+  int best = 0;
+  for (const uint16_t *field = table.dist.data(), *end = field + table.dist.size(); field != end; field += numTiles)
+  {
+    const uint16_t fromDist = field[from_idx];
+    const uint16_t toDist = field[to_idx];
+    if (fromDist == landmark_unreachable || toDist == landmark_unreachable)
+      continue;
+    best = std::max(best, std::abs(int(fromDist) - int(toDist)));
+  }
+  return float(best);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "math.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+constexpr uint16_t landmark_unreachable = UINT16_MAX;
+
+// BFS distance fields from a few well spread tiles (ALT heuristic)
+// by triangle inequality |d(L, a) - d(L, b)| <= d(a, b), and as every move costs at least 1
+// the bound stays admissible on maps with water too
+struct LandmarkTable
+{
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<Position> landmarks;
+  std::vector<uint16_t> dist; // landmarks.size() fields of width * height, landmark_unreachable if no path
+
+  size_t memory_bytes() const { return dist.size() * sizeof(uint16_t); }
+};
+
+// picks landmarks by farthest point sampling, long distances saturate which keeps the bound admissible
+LandmarkTable build_landmarks(const char *input, size_t width, size_t height, size_t num_landmarks);
+
+float landmark_heuristic(const LandmarkTable &table, size_t from_idx, size_t to_idx);
@@ -2,11 +2,19 @@
 #include <functional>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <chrono>
 #include <float.h>
 #include <cmath>
 #include "math.h"
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
+#include "pathfinder.h"
+#include "jumpPointSearch.h"
+#include "landmarks.h"
+#include "idaStar.h"
+#include "dStarLite.h"
+#include "araStar.h"
 #include <stdio.h>
 #include <stdint.h>
 
@@ -38,160 +46,169 @@ static void draw_path(std::vector<Position> path)
   }
 }
 
-static std::vector<Position> reconstruct_path(std::vector<Position> prev, Position to, size_t width)
+// compares A* and JPS on a uniform cost copy of the map (water turned into floor)
+static void benchmark_jps(const char *input, size_t width, size_t height, size_t num_queries)
 {
-  Position curPos = to;
-  std::vector<Position> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != Position{-1, -1})
+  std::vector<char> uniform(input, input + width * height);
+  std::replace(uniform.begin(), uniform.end(), dungeon::water, dungeon::floor);
+  SearchContext &ctx = get_thread_search_context();
+  std::vector<Position> path;
+  size_t expanded[2] = {0, 0};
+  double timeUs[2] = {0.0, 0.0};
+  size_t mismatches = 0;
+  for (size_t i = 0; i < num_queries; ++i)
   {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
+    const Position from = dungeon::find_walkable_tile(uniform.data(), width, height);
+    const Position to = dungeon::find_walkable_tile(uniform.data(), width, height);
+    size_t pathLen[2] = {0, 0};
+    for (int algo = 0; algo < 2; ++algo)
+    {
+      PathStats stats;
+      const auto startTime = std::chrono::steady_clock::now();
+      if (algo == 0)
+        find_path_a_star(ctx, uniform.data(), width, height, from, to, 1.f, path, &stats);
+      else
+        find_path_jps(ctx, uniform.data(), width, height, false, from, to, 1.f, path, &stats);
+      const auto endTime = std::chrono::steady_clock::now();
+      timeUs[algo] += std::chrono::duration<double, std::micro>(endTime - startTime).count();
+      expanded[algo] += stats.nodesExpanded;
+      pathLen[algo] = path.size();
+    }
+    if (pathLen[0] != pathLen[1])
+      ++mismatches;
   }
-  return res;
+  const double n = double(num_queries);
+  printf("A*:  %.1f nodes expanded, %.2f us per query\n", double(expanded[0]) / n, timeUs[0] / n);
+  printf("JPS: %.1f nodes expanded, %.2f us per query\n", double(expanded[1]) / n, timeUs[1] / n);
+  if (mismatches > 0)
+    printf("JPS path length differs from A* in %zu queries\n", mismatches);
 }
 
-float heuristic(Position lhs, Position rhs)
-{
-  return sqrtf(square(float(lhs.x - rhs.x)) + square(float(lhs.y - rhs.y)));
-};
-
-static float ida_star_search(const char *input, size_t width, size_t height, std::vector<Position> &path, const float g, const float bound, Position to)
+// compares plain A* against ALT with different landmark counts on random queries
+static void benchmark_landmarks(const char *input, size_t width, size_t height, size_t num_queries)
 {
-  const Position &p = path.back();
-  const float f = g + heuristic(p, to);
-  if (f > bound)
-    return f;
-  if (p == to)
-    return -f;
-  float min = FLT_MAX;
-  auto checkNeighbour = [&](Position p) -> float
+  std::vector<std::pair<Position, Position>> queries(num_queries);
+  for (auto &query : queries)
+    query = {dungeon::find_walkable_tile(input, width, height), dungeon::find_walkable_tile(input, width, height)};
+  SearchContext &ctx = get_thread_search_context();
+  std::vector<Position> path;
+  size_t baseExpanded = 0;
+  auto startTime = std::chrono::steady_clock::now();
+  for (const auto &[from, to] : queries)
   {
-    // out of bounds
-    if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-      return 0.f;
-    size_t idx = coord_to_idx(p.x, p.y, width);
-    // not empty
-    if (input[idx] == '#')
-      return 0.f;
-    if (std::find(path.begin(), path.end(), p) != path.end())
-      return 0.f;
-    path.push_back(p);
-    float weight = input[idx] == 'o' ? 10.f : 1.f;
-    float gScore = g + 1.f * weight; // we're exactly 1 unit away
-    const float t = ida_star_search(input, width, height, path, gScore, bound, to);
-    if (t < 0.f)
-      return t;
-    if (t < min)
-      min = t;
-    path.pop_back();
-    return t;
-  };
-  float lv = checkNeighbour({p.x + 1, p.y + 0});
-  if (lv < 0.f) return lv;
-  float rv = checkNeighbour({p.x - 1, p.y + 0});
-  if (rv < 0.f) return rv;
-  float tv = checkNeighbour({p.x + 0, p.y + 1});
-  if (tv < 0.f) return tv;
-  float bv = checkNeighbour({p.x + 0, p.y - 1});
-  if (bv < 0.f) return bv;
-  return min;
-}
-
-static std::vector<Position> find_ida_star_path(const char *input, size_t width, size_t height, Position from, Position to)
-{
-  float bound = heuristic(from, to);
-  std::vector<Position> path = {from};
-  while (true)
+    PathStats stats;
+    find_path_a_star(ctx, input, width, height, from, to, 1.f, path, &stats);
+    baseExpanded += stats.nodesExpanded;
+  }
+  const double n = double(num_queries);
+  const double baseUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+  printf("A*: %.1f nodes expanded, %.2f us per query\n", double(baseExpanded) / n, baseUs / n);
+  for (size_t numLandmarks : {1, 2, 4, 8, 16})
   {
-    const float t = ida_star_search(input, width, height, path, 0.f, bound, to);
-    if (t < 0.f)
-      return path;
-    if (t == FLT_MAX)
-      return {};
-    bound = t;
-    printf("new bound %0.1f\n", bound);
+    startTime = std::chrono::steady_clock::now();
+    const LandmarkTable table = build_landmarks(input, width, height, numLandmarks);
+    const double buildMs =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    size_t expanded = 0;
+    startTime = std::chrono::steady_clock::now();
+    for (const auto &[from, to] : queries)
+    {
+      PathStats stats;
+      find_path_alt(ctx, input, width, height, table, from, to, 1.f, path, &stats);
+      expanded += stats.nodesExpanded;
+    }
+    const double timeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+    printf("ALT x%zu: %zu KB, built in %.2f ms, %.1f nodes expanded (%.2fx fewer), %.2f us per query\n",
+           numLandmarks, table.memory_bytes() / 1024, buildMs, double(expanded) / n,
+           double(baseExpanded) / double(std::max<size_t>(expanded, 1)), timeUs / n);
   }
-  return {};
 }
 
-static std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+// everything the viewer's path depends on, map version is bumped on every edit of the grid
+struct NavQuery
 {
-  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
-    return std::vector<Position>();
-  size_t inpSize = width * height;
+  size_t mapVersion = 0;
+  Position from;
+  Position to;
+  float weight = 1.f;
+  bool useJps = false;
+  bool useLandmarks = false;
+  bool useDStar = false;
+  bool useAra = false;
+};
 
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<Position> prev(inpSize, {-1,-1});
+static bool operator==(const NavQuery &lhs, const NavQuery &rhs)
+{
+  return lhs.mapVersion == rhs.mapVersion && lhs.from == rhs.from && lhs.to == rhs.to && lhs.weight == rhs.weight &&
+         lhs.useJps == rhs.useJps && lhs.useLandmarks == rhs.useLandmarks && lhs.useDStar == rhs.useDStar &&
+         lhs.useAra == rhs.useAra;
+}
 
-  auto getG = [&](Position p) -> float { return g[coord_to_idx(p.x, p.y, width)]; };
-  auto getF = [&](Position p) -> float { return f[coord_to_idx(p.x, p.y, width)]; };
+struct ExpandedNode
+{
+  Position pos;
+  float g;
+};
 
-  g[coord_to_idx(from.x, from.y, width)] = 0;
-  f[coord_to_idx(from.x, from.y, width)] = weight * heuristic(from, to);
+// result of the last search with its expansion trace, drawn every frame without searching again
+struct NavQueryResult
+{
+  bool valid = false;
+  NavQuery query;
+  std::vector<Position> path;
+  std::vector<ExpandedNode> trace;
+  PathStats stats;
+};
+
+constexpr float ara_budget_us = 1000.f;
 
-  std::vector<Position> openList = {from};
-  std::vector<Position> closedList;
+// anytime planner gets another slice of time every frame until its path is optimal
+static void improve_nav_result(AraStarPlanner &ara_planner, NavQueryResult &result)
+{
+  PathStats stats;
+  ara_planner.improve(ara_budget_us, result.path, &stats,
+                      [&](Position p, float g) { result.trace.push_back({p, g}); });
+  result.stats.nodesExpanded += stats.nodesExpanded;
+}
 
-  while (!openList.empty())
+static void solve_nav_query(const char *input, size_t width, size_t height, const NavQuery &query,
+                            const LandmarkTable &landmarks, bool weighted_tiles, DStarLitePlanner &planner,
+                            AraStarPlanner &ara_planner, NavQueryResult &result)
+{
+  result.valid = true;
+  result.query = query;
+  result.trace.clear();
+  auto recordExpanded = [&](Position p, float g) { result.trace.push_back({p, g}); };
+  SearchContext &ctx = get_thread_search_context();
+  if (query.useAra)
   {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
-    {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
-    }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, width);
-    Position curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, width);
-    const Rectangle rect = {float(curPos.x), float(curPos.y), 1.f, 1.f};
-    DrawRectangleRec(rect, Color{uint8_t(g[idx]), uint8_t(g[idx]), 0, 100});
-    closedList.emplace_back(curPos);
-    auto checkNeighbour = [&](Position p)
-    {
-      // out of bounds
-      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-        return;
-      size_t idx = coord_to_idx(p.x, p.y, width);
-      // not empty
-      if (input[idx] == '#')
-        return;
-      float edgeWeight = input[idx] == 'o' ? 10.f : 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
-      {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + weight * heuristic(p, to);
-      }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
-    };
-    checkNeighbour({curPos.x + 1, curPos.y + 0});
-    checkNeighbour({curPos.x - 1, curPos.y + 0});
-    checkNeighbour({curPos.x + 0, curPos.y + 1});
-    checkNeighbour({curPos.x + 0, curPos.y - 1});
+    result.stats = PathStats{};
+    ara_planner.start(input, width, height, query.from, query.to, std::max(query.weight, 3.f));
+    improve_nav_result(ara_planner, result);
   }
-  // empty path
-  return std::vector<Position>();
+  else if (query.useDStar)
+    planner.compute_path(result.path, &result.stats, recordExpanded);
+  else if (query.useLandmarks)
+    find_path_alt(ctx, input, width, height, landmarks, query.from, query.to, query.weight, result.path,
+                  &result.stats, recordExpanded);
+  else if (query.useJps)
+    find_path_jps(ctx, input, width, height, weighted_tiles, query.from, query.to, query.weight, result.path,
+                  &result.stats, recordExpanded);
+  else
+    find_path_a_star(ctx, input, width, height, query.from, query.to, query.weight, result.path, &result.stats,
+                     recordExpanded);
+  //find_path_ida_star(input, width, height, query.from, query.to, result.path, &result.stats);
 }
 
-void draw_nav_data(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+static void draw_nav_result(const char *input, size_t width, size_t height, const NavQueryResult &result)
 {
   draw_nav_grid(input, width, height);
-  std::vector<Position> path = find_path_a_star(input, width, height, from, to, weight);
-  //std::vector<Position> path = find_ida_star_path(input, width, height, from, to);
-  draw_path(path);
+  for (const ExpandedNode &node : result.trace)
+  {
+    const Rectangle rect = {float(node.pos.x), float(node.pos.y), 1.f, 1.f};
+    DrawRectangleRec(rect, Color{uint8_t(node.g), uint8_t(node.g), 0, 100});
+  }
+  draw_path(result.path);
 }
 
 int main(int /*argc*/, const char ** /*argv*/)
@@ -215,9 +232,21 @@ int main(int /*argc*/, const char ** /*argv*/)
   gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
   spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
   float weight = 1.f;
+  bool useJps = false;
+  bool useLandmarks = false;
+  constexpr size_t numLandmarks = 8;
+  LandmarkTable landmarks = build_landmarks(navGrid, dungWidth, dungHeight, numLandmarks);
+  bool weightedTiles = has_weighted_tiles(navGrid, dungWidth, dungHeight);
 
   Position from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
   Position to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
+  bool useDStar = false;
+  DStarLitePlanner planner;
+  planner.init(navGrid, dungWidth, dungHeight, from, to);
+  bool useAra = false;
+  AraStarPlanner araPlanner;
+  size_t mapVersion = 0;
+  NavQueryResult navResult;
 
   Camera2D camera = { {0, 0}, {0, 0}, 0.f, 1.f };
   //camera.offset = Vector2{ width * 0.5f, height * 0.5f };
@@ -233,25 +262,67 @@ int main(int /*argc*/, const char ** /*argv*/)
     {
       size_t idx = coord_to_idx(p.x, p.y, dungWidth);
       if (idx < dungWidth * dungHeight)
+      {
         navGrid[idx] = navGrid[idx] == ' ' ? '#' : navGrid[idx] == '#' ? 'o' : ' ';
+        ++mapVersion;
+        landmarks = build_landmarks(navGrid, dungWidth, dungHeight, numLandmarks);
+        weightedTiles = has_weighted_tiles(navGrid, dungWidth, dungHeight);
+        planner.notify_tile_changed(p);
+      }
     }
     else if (IsMouseButtonPressed(0))
     {
       Position &target = from;
       target = p;
+      planner.move_start(from);
     }
     else if (IsMouseButtonPressed(1))
     {
       Position &target = to;
       target = p;
+      planner.init(navGrid, dungWidth, dungHeight, from, to);
     }
     if (IsKeyPressed(KEY_SPACE))
     {
       gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
       spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
+      ++mapVersion;
+      landmarks = build_landmarks(navGrid, dungWidth, dungHeight, numLandmarks);
+      weightedTiles = has_weighted_tiles(navGrid, dungWidth, dungHeight);
       from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
       to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
+      planner.init(navGrid, dungWidth, dungHeight, from, to);
+    }
+    if (IsKeyPressed(KEY_D))
+    {
+      useDStar = !useDStar;
+      printf("D* Lite %s\n", useDStar ? "on" : "off");
+    }
+    // agent takes a step along the D* Lite path
+    if (IsKeyPressed(KEY_S) && useDStar && navResult.query.useDStar && navResult.path.size() > 1)
+    {
+      from = navResult.path[1];
+      planner.move_start(from);
+    }
+    if (IsKeyPressed(KEY_A))
+    {
+      useAra = !useAra;
+      printf("ARA* %s\n", useAra ? "on" : "off");
+    }
+    if (IsKeyPressed(KEY_J))
+    {
+      useJps = !useJps;
+      printf("jump point search %s\n", useJps ? "on" : "off");
+    }
+    if (IsKeyPressed(KEY_L))
+    {
+      useLandmarks = !useLandmarks;
+      printf("landmark heuristic %s\n", useLandmarks ? "on" : "off");
     }
+    if (IsKeyPressed(KEY_B))
+      benchmark_jps(navGrid, dungWidth, dungHeight, 1000);
+    if (IsKeyPressed(KEY_N))
+      benchmark_landmarks(navGrid, dungWidth, dungHeight, 1000);
     if (IsKeyPressed(KEY_UP))
     {
       weight += 0.1f;
@@ -262,11 +333,21 @@ int main(int /*argc*/, const char ** /*argv*/)
       weight = std::max(1.f, weight - 0.1f);
       printf("new weight %f\n", weight);
     }
+    // search only when something it depends on has changed
+    const NavQuery query{mapVersion, from, to, weight, useJps, useLandmarks, useDStar, useAra};
+    if (!navResult.valid || !(navResult.query == query))
+      solve_nav_query(navGrid, dungWidth, dungHeight, query, landmarks, weightedTiles, planner, araPlanner,
+                      navResult);
+    else if (useAra && !araPlanner.is_optimal())
+      improve_nav_result(araPlanner, navResult);
     BeginDrawing();
       ClearBackground(BLACK);
       BeginMode2D(camera);
-        draw_nav_data(navGrid, dungWidth, dungHeight, from, to, weight);
+        draw_nav_result(navGrid, dungWidth, dungHeight, navResult);
       EndMode2D();
+      DrawText(TextFormat("expanded %d nodes", int(navResult.stats.nodesExpanded)), 10, 10, 20, WHITE);
+      if (useAra)
+        DrawText(TextFormat("ARA* suboptimality %.1f", araPlanner.get_suboptimality()), 10, 35, 20, WHITE);
     EndDrawing();
   }
   CloseWindow();
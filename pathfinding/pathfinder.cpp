@@ -0,0 +1,127 @@
+#include "pathfinder.h"
+#include "dungeonUtils.h"
+#include "landmarks.h"
+#include <cmath>
+#include <algorithm>
+
+template<typename T>
+static size_t coord_to_idx(T x, T y, size_t w)
+{
+  return size_t(y) * w + size_t(x);
+}
+
+float heuristic(Position lhs, Position rhs)
+{
+  return sqrtf(square(float(lhs.x - rhs.x)) + square(float(lhs.y - rhs.y)));
+}
+
+static void reconstruct_path(const SearchContext &ctx, size_t to_idx, size_t width,
+                             std::vector<Position> &out_path)
+{
+  size_t len = 0;
+  for (size_t idx = to_idx; idx != invalid_node; idx = ctx.get_prev(idx))
+    ++len;
+  out_path.resize(len);
+  for (size_t idx = to_idx; idx != invalid_node; idx = ctx.get_prev(idx))
+    out_path[--len] = Position{int(idx % width), int(idx / width)};
+}
+
+template<typename Heuristic>
+static bool a_star_search(SearchContext &ctx, const char *input, size_t width, size_t height,
+                          Position from, Position to, float weight, std::vector<Position> &out_path,
+                          PathStats *stats, const ExpandCallback &on_expand, const Heuristic &estimate)
+{
+  out_path.clear();
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return false;
+  ctx.reset(width * height);
+  IndexedHeap &openList = ctx.openList;
+
+  const size_t fromIdx = coord_to_idx(from.x, from.y, width);
+  ctx.set_g(fromIdx, 0.f, invalid_node);
+  ctx.set_state(fromIdx, NS_OPEN);
+  openList.push(fromIdx, weight * estimate(fromIdx, from));
+
+  size_t nodesExpanded = 0;
+  bool found = false;
+  while (!openList.empty())
+  {
+    const size_t idx = openList.pop();
+    ctx.set_state(idx, NS_CLOSED);
+    const Position curPos{int(idx % width), int(idx / width)};
+    if (curPos == to)
+    {
+      reconstruct_path(ctx, idx, width, out_path);
+      found = true;
+      break;
+    }
+    ++nodesExpanded;
+    const float curG = ctx.get_g(idx);
+    if (on_expand)
+      on_expand(curPos, curG);
+    auto checkNeighbour = [&](Position p)
+    {
+      // out of bounds
+      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+        return;
+      size_t nidx = coord_to_idx(p.x, p.y, width);
+      // not empty
+      if (input[nidx] == dungeon::wall)
+        return;
+      const uint8_t nstate = ctx.get_state(nidx);
+      if (nstate == NS_CLOSED)
+        return;
+      float edgeWeight = input[nidx] == dungeon::water ? 10.f : 1.f;
+      float gScore = curG + 1.f * edgeWeight; // we're exactly 1 unit away
+      if (gScore >= ctx.get_g(nidx))
+        return;
+      ctx.set_g(nidx, gScore, idx);
+      const float fScore = gScore + weight * estimate(nidx, p);
+      if (nstate == NS_OPEN)
+        openList.decrease_key(nidx, fScore);
+      else
+      {
+        ctx.set_state(nidx, NS_OPEN);
+        openList.push(nidx, fScore);
+      }
+    };
+    checkNeighbour({curPos.x + 1, curPos.y + 0});
+    checkNeighbour({curPos.x - 1, curPos.y + 0});
+    checkNeighbour({curPos.x + 0, curPos.y + 1});
+    checkNeighbour({curPos.x + 0, curPos.y - 1});
+  }
+  if (stats)
+    stats->nodesExpanded = nodesExpanded;
+  return found;
+}
+
+bool find_path_a_star(SearchContext &ctx, const char *input, size_t width, size_t height,
+                      Position from, Position to, float weight, std::vector<Position> &out_path,
+                      PathStats *stats, const ExpandCallback &on_expand)
+{
+  return a_star_search(ctx, input, width, height, from, to, weight, out_path, stats, on_expand,
+    [&](size_t, Position p) { return heuristic(p, to); });
+}
+
+bool find_path_alt(SearchContext &ctx, const char *input, size_t width, size_t height, const LandmarkTable &landmarks,
+                   Position from, Position to, float weight, std::vector<Position> &out_path,
+                   PathStats *stats, const ExpandCallback &on_expand)
+{
+  if (to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+  {
+    out_path.clear();
+    return false;
+  }
+  const size_t toIdx = coord_to_idx(to.x, to.y, width);
+  return a_star_search(ctx, input, width, height, from, to, weight, out_path, stats, on_expand,
+    [&](size_t idx, Position p) { return std::max(heuristic(p, to), landmark_heuristic(landmarks, idx, toIdx)); });
+}
+
+std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height,
+                                       Position from, Position to, float weight,
+                                       PathStats *stats, const ExpandCallback &on_expand)
+{
+  std::vector<Position> res;
+  find_path_a_star(get_thread_search_context(), input, width, height, from, to, weight, res, stats, on_expand);
+  return res;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "math.h"
+#include "searchContext.h"
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+struct PathStats
+{
+  size_t nodesExpanded = 0;
+};
+
+// called for every node taken from the open list, used for debug visualisation
+using ExpandCallback = std::function<void(Position pos, float g)>;
+
+float heuristic(Position lhs, Position rhs);
+
+// writes path into out_path (cleared on failure), returns false if there's no path
+bool find_path_a_star(SearchContext &ctx, const char *input, size_t width, size_t height,
+                      Position from, Position to, float weight, std::vector<Position> &out_path,
+                      PathStats *stats = nullptr, const ExpandCallback &on_expand = {});
+
+// same as above, but uses context of the calling thread and allocates the result
+std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height,
+                                       Position from, Position to, float weight,
+                                       PathStats *stats = nullptr,
+                                       const ExpandCallback &on_expand = {});
+
+struct LandmarkTable;
+
+// A* guided by the landmark table built for the same map, tighter than euclidean distance on maze-like maps
+bool find_path_alt(SearchContext &ctx, const char *input, size_t width, size_t height, const LandmarkTable &landmarks,
+                   Position from, Position to, float weight, std::vector<Position> &out_path,
+                   PathStats *stats = nullptr, const ExpandCallback &on_expand = {});
@@ -1,6 +1,9 @@
 #include "dijkstraMapGen.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 
 template<typename Callable>
 static void query_dungeon_data(flecs::world &ecs, Callable c)
@@ -27,42 +30,140 @@ static void init_tiles(std::vector<float> &map, const DungeonData &dd)
     v = invalid_tile_value;
 }
 
-// scan version, could be implemented as Dijkstra version as well
-static void process_dmap(std::vector<float> &map, const DungeonData &dd)
+// Dial's buckets one step wide, every step costs exactly 1 so tiles of one bucket can't improve each other
+// and seeds don't have to be integer (flee map multiplies distances by -1.2)
+struct DmapBuckets
+{
+  float base = 0.f;
+  std::vector<std::vector<uint32_t>> buckets;
+  size_t current = 0;
+  size_t count = 0;
+
+  explicit DmapBuckets(float min_value) : base(min_value) {}
+
+  void push(float value, uint32_t idx)
+  {
+    const size_t bucket = size_t(value - base);
+    if (bucket >= buckets.size())
+      buckets.resize(bucket + 1);
+    buckets[bucket].push_back(idx);
+    ++count;
+  }
+  bool empty() const { return count == 0; }
+  uint32_t pop()
+  {
+    while (buckets[current].empty())
+      ++current;
+    const uint32_t idx = buckets[current].back();
+    buckets[current].pop_back();
+    --count;
+    return idx;
+  }
+};
+
+// radix heap over float keys mapped onto unsigned ints in the same order, for seeds spread too far for buckets
+// keys are never below the last popped one, which holds for Dijkstra as long as it starts at the smallest seed
+struct DmapRadixHeap
 {
-  bool done = false;
-  auto getMapAt = [&](size_t x, size_t y, float def)
+  std::vector<std::pair<uint32_t, uint32_t>> buckets[33];
+  uint32_t last = 0;
+  size_t count = 0;
+
+  explicit DmapRadixHeap(float min_value) : last(to_key(min_value)) {}
+
+  static uint32_t to_key(float value)
   {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
-      return map[y * dd.width + x];
-    return def;
-  };
-  auto getMinNei = [&](size_t x, size_t y)
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  }
+  size_t bucket_of(uint32_t key) const { return key == last ? 0 : size_t(32 - std::countl_zero(key ^ last)); }
+
+  void push(float value, uint32_t idx)
   {
-    float val = map[y * dd.width + x];
-    val = std::min(val, getMapAt(x - 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 0, y - 1, val));
-    val = std::min(val, getMapAt(x + 0, y + 1, val));
-    return val;
-  };
-  while (!done)
+    const uint32_t key = to_key(value);
+    buckets[bucket_of(key)].emplace_back(key, idx);
+    ++count;
+  }
+  bool empty() const { return count == 0; }
+  uint32_t pop()
   {
-    done = true;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-      {
-        const size_t i = y * dd.width + x;
-        if (dd.tiles[i] != dungeon::floor)
-          continue;
-        const float myVal = getMapAt(x, y, invalid_tile_value);
-        const float minVal = getMinNei(x, y);
-        if (minVal < myVal - 1.f)
-        {
-          map[i] = minVal + 1.f;
-          done = false;
-        }
-      }
+    if (buckets[0].empty())
+    {
+      size_t i = 1;
+      while (buckets[i].empty())
+        ++i;
+      last = std::min_element(buckets[i].begin(), buckets[i].end())->first;
+      // everything lands in lower buckets, so the one being read isn't touched
+      for (const auto &item : buckets[i])
+        buckets[bucket_of(item.first)].push_back(item);
+      buckets[i].clear();
+    }
+    const uint32_t idx = buckets[0].back().second;
+    buckets[0].pop_back();
+    --count;
+    return idx;
+  }
+};
+
+template<typename Queue>
+static void propagate_dmap(std::vector<float> &map, const DungeonData &dd, const std::vector<uint32_t> &seeds,
+                           Queue &queue)
+{
+  for (uint32_t idx : seeds)
+    queue.push(map[idx], idx);
+  // a tile may sit in the queue several times, only its first pop has the final value
+  std::vector<bool> settled(map.size(), false);
+  while (!queue.empty())
+  {
+    const uint32_t idx = queue.pop();
+    if (settled[idx])
+      continue;
+    settled[idx] = true;
+    const size_t x = idx % dd.width;
+    const size_t y = idx / dd.width;
+    const float nextVal = map[idx] + 1.f;
+    auto relax = [&](size_t nx, size_t ny)
+    {
+      if (nx >= dd.width || ny >= dd.height)
+        return;
+      const size_t i = ny * dd.width + nx;
+      if (dd.tiles[i] != dungeon::floor || nextVal >= map[i])
+        return;
+      map[i] = nextVal;
+      queue.push(nextVal, uint32_t(i));
+    };
+    relax(x - 1, y + 0);
+    relax(x + 1, y + 0);
+    relax(x + 0, y - 1);
+    relax(x + 0, y + 1);
+  }
+}
+
+// multi source Dijkstra, every floor tile with a value is a seed
+static void process_dmap(std::vector<float> &map, const DungeonData &dd)
+{
+  std::vector<uint32_t> seeds;
+  float minSeed = invalid_tile_value;
+  float maxSeed = -invalid_tile_value;
+  for (size_t i = 0; i < map.size(); ++i)
+    if (dd.tiles[i] == dungeon::floor && map[i] < invalid_tile_value)
+    {
+      seeds.push_back(uint32_t(i));
+      minSeed = std::min(minSeed, map[i]);
+      maxSeed = std::max(maxSeed, map[i]);
+    }
+  if (seeds.empty())
+    return;
+  // buckets have to cover every value from the smallest seed on, most of them would be empty for a wide spread
+  if (maxSeed - minSeed <= float(map.size()))
+  {
+    DmapBuckets queue(minSeed);
+    propagate_dmap(map, dd, seeds, queue);
+  }
+  else
+  {
+    DmapRadixHeap queue(minSeed);
+    propagate_dmap(map, dd, seeds, queue);
   }
 }
 
@@ -170,6 +170,7 @@ struct DmapWeights
     float pow = 1.f;
   };
   std::unordered_map<std::string, WtData> weights;
+  size_t profile = size_t(-1); // interned by compose_weighted_dmaps
 };
 
 struct Hive {};
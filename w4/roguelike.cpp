@@ -313,21 +313,13 @@ static void register_roguelike_systems(flecs::world &ecs)
     {
       dungeonDataQuery.each([&](const DungeonData &dd)
       {
+        const std::vector<float> *field = find_weighted_dmap(wt);
+        if (!field)
+          return;
         for (size_t y = 0; y < dd.height; ++y)
           for (size_t x = 0; x < dd.width; ++x)
           {
-            float sum = 0.f;
-            for (const auto &pair : wt.weights)
-            {
-              ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
-              {
-                float v = dmap.map[y * dd.width + x];
-                if (v < 1e5f)
-                  sum += powf(v * pair.second.mult, pair.second.pow);
-                else
-                  sum += v;
-              });
-            }
+            const float sum = (*field)[y * dd.width + x];
             if (sum < 1e5f)
               DrawText(TextFormat("%.1f", sum),
                   (float(x) + 0.2f) * tile_size, (float(y) + 0.5f) * tile_size, 150, WHITE);
@@ -400,6 +392,10 @@ void init_roguelike(flecs::world &ecs)
   ecs.entity("world")
     .set(TurnCounter{})
     .set(ActionLog{});
+
+  // set once, setting it every turn would drop its interned profile
+  ecs.entity("hive_follower_sum")
+    .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}});
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
@@ -659,10 +655,8 @@ void process_turn(flecs::world &ecs)
     ecs.entity("exploration_map")
       .set(DijkstraMapData{explorationMap});
 
-    ecs.entity("hive_follower_sum")
-      .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}});
-
     ecs.entity("exploration_map").add<VisualiseMap>();
+    compose_weighted_dmaps(ecs);
   }
 }
 
@@ -22,7 +22,7 @@ public:
   {
     on_closest_enemy_pos(ecs, entity, [&](Action &a, const Position &pos, const Position &enemy_pos)
     {
-      a.action = move_towards(pos, enemy_pos);
+      a.action = move_along_path(ecs, pos, enemy_pos);
     });
   }
 };
@@ -49,12 +49,12 @@ public:
   PatrolState(float dist) : patrolDist(dist) {}
   void enter() const override {}
   void exit() const override {}
-  void act(float/* dt*/, flecs::world &, flecs::entity entity) const override
+  void act(float/* dt*/, flecs::world &ecs, flecs::entity entity) const override
   {
     entity.set([&](const Position &pos, const PatrolPos &ppos, Action &a)
     {
       if (dist(pos, ppos) > patrolDist)
-        a.action = move_towards(pos, ppos); // do a recovery walk
+        a.action = move_along_path(ecs, pos, ppos); // do a recovery walk
       else
       {
         // do a random walk
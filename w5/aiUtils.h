@@ -3,6 +3,7 @@
 #include "blackboard.h"
 #include <float.h>
 #include "math.h"
+#include "pathDatabase.h"
 
 template<typename T, typename U>
 inline int move_towards(const T &from, const U &to)
@@ -14,6 +15,21 @@ inline int move_towards(const T &from, const U &to)
   return deltaY < 0 ? EA_MOVE_UP : EA_MOVE_DOWN;
 }
 
+// next step of a shortest path out of the path database, a greedy step if the dungeon has none
+template<typename T, typename U>
+inline int move_along_path(flecs::world &ecs, const T &from, const U &to)
+{
+  static auto pathDatabaseQuery = ecs.query<const PathDatabase>();
+  int move = EA_NOP;
+  bool found = false;
+  pathDatabaseQuery.each([&](const PathDatabase &db)
+  {
+    move = first_move(db, Position{from.x, from.y}, Position{to.x, to.y});
+    found = true;
+  });
+  return found ? move : move_towards(from, to);
+}
+
 inline int inverse_move(int move)
 {
   return move == EA_MOVE_LEFT ? EA_MOVE_RIGHT :
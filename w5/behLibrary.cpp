@@ -87,7 +87,7 @@ struct MoveToEntity : public BehNode
     entityBb = reg_entity_blackboard_var<flecs::entity>(entity, bb_name);
   }
 
-  BehResult update(flecs::world &, flecs::entity entity, Blackboard &bb) override
+  BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
     BehResult res = BEH_RUNNING;
     entity.set([&](Action &a, const Position &pos)
@@ -102,7 +102,7 @@ struct MoveToEntity : public BehNode
       {
         if (pos != target_pos)
         {
-          a.action = move_towards(pos, target_pos);
+          a.action = move_along_path(ecs, pos, target_pos);
           res = BEH_RUNNING;
         }
         else
@@ -210,14 +210,14 @@ struct Patrol : public BehNode
     });
   }
 
-  BehResult update(flecs::world &, flecs::entity entity, Blackboard &bb) override
+  BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
     BehResult res = BEH_RUNNING;
     entity.set([&](Action &a, const Position &pos)
     {
       Position patrolPos = bb.get<Position>(pposBb);
       if (dist(pos, patrolPos) > patrolDist)
-        a.action = move_towards(pos, patrolPos);
+        a.action = move_along_path(ecs, pos, patrolPos);
       else
         a.action = GetRandomValue(EA_MOVE_START, EA_MOVE_END - 1); // do a random walk
     });
@@ -1,14 +1,11 @@
 #include "dijkstraMapGen.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
-
-template<typename Callable>
-static void query_dungeon_data(flecs::world &ecs, Callable c)
-{
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
-
-  dungeonDataQuery.each(c);
-}
+#include "dmapSweep.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
 
 template<typename Callable>
 static void query_characters_positions(flecs::world &ecs, Callable c)
@@ -20,6 +17,13 @@ static void query_characters_positions(flecs::world &ecs, Callable c)
 
 constexpr float invalid_tile_value = 1e5f;
 
+static dmaps::DmapKernel dmapKernel = dmaps::DmapKernel::Dijkstra;
+
+void dmaps::set_dmap_kernel(DmapKernel kernel)
+{
+  dmapKernel = kernel;
+}
+
 static void init_tiles(std::vector<float> &map, const DungeonData &dd)
 {
   map.resize(dd.width * dd.height);
@@ -27,82 +31,296 @@ static void init_tiles(std::vector<float> &map, const DungeonData &dd)
     v = invalid_tile_value;
 }
 
-// scan version, could be implemented as Dijkstra version as well
+// Dial's buckets one step wide, every step costs exactly 1 so tiles of one bucket can't improve each other
+// and seeds don't have to be integer (flee map multiplies distances by -1.2)
+struct DmapBuckets
+{
+  float base = 0.f;
+  std::vector<std::vector<uint32_t>> buckets;
+  size_t current = 0;
+  size_t count = 0;
+
+  explicit DmapBuckets(float min_value) : base(min_value) {}
+
+  void push(float value, uint32_t idx)
+  {
+    const size_t bucket = size_t(value - base);
+    if (bucket >= buckets.size())
+      buckets.resize(bucket + 1);
+    buckets[bucket].push_back(idx);
+    ++count;
+  }
+  bool empty() const { return count == 0; }
+  uint32_t pop()
+  {
+    while (buckets[current].empty())
+      ++current;
+    const uint32_t idx = buckets[current].back();
+    buckets[current].pop_back();
+    --count;
+    return idx;
+  }
+};
+
+// radix heap over float keys mapped onto unsigned ints in the same order, for seeds spread too far for buckets
+// keys are never below the last popped one, which holds for Dijkstra as long as it starts at the smallest seed
+struct DmapRadixHeap
+{
+  std::vector<std::pair<uint32_t, uint32_t>> buckets[33];
+  uint32_t last = 0;
+  size_t count = 0;
+
+  explicit DmapRadixHeap(float min_value) : last(to_key(min_value)) {}
+
+  static uint32_t to_key(float value)
+  {
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+  }
+  size_t bucket_of(uint32_t key) const { return key == last ? 0 : size_t(32 - std::countl_zero(key ^ last)); }
+
+  void push(float value, uint32_t idx)
+  {
+    const uint32_t key = to_key(value);
+    buckets[bucket_of(key)].emplace_back(key, idx);
+    ++count;
+  }
+  bool empty() const { return count == 0; }
+  uint32_t pop()
+  {
+    if (buckets[0].empty())
+    {
+      size_t i = 1;
+      while (buckets[i].empty())
+        ++i;
+      last = std::min_element(buckets[i].begin(), buckets[i].end())->first;
+      // everything lands in lower buckets, so the one being read isn't touched
+      for (const auto &item : buckets[i])
+        buckets[bucket_of(item.first)].push_back(item);
+      buckets[i].clear();
+    }
+    const uint32_t idx = buckets[0].back().second;
+    buckets[0].pop_back();
+    --count;
+    return idx;
+  }
+};
+
+template<typename Queue>
+static void propagate_dmap(std::vector<float> &map, const DungeonData &dd, const std::vector<uint32_t> &seeds,
+                           Queue &queue)
+{
+  for (uint32_t idx : seeds)
+    queue.push(map[idx], idx);
+  // a tile may sit in the queue several times, only its first pop has the final value
+  std::vector<bool> settled(map.size(), false);
+  while (!queue.empty())
+  {
+    const uint32_t idx = queue.pop();
+    if (settled[idx])
+      continue;
+    settled[idx] = true;
+    const size_t x = idx % dd.width;
+    const size_t y = idx / dd.width;
+    const float nextVal = map[idx] + 1.f;
+    auto relax = [&](size_t nx, size_t ny)
+    {
+      if (nx >= dd.width || ny >= dd.height)
+        return;
+      const size_t i = ny * dd.width + nx;
+      if (dd.tiles[i] != dungeon::floor || nextVal >= map[i])
+        return;
+      map[i] = nextVal;
+      queue.push(nextVal, uint32_t(i));
+    };
+    relax(x - 1, y + 0);
+    relax(x + 1, y + 0);
+    relax(x + 0, y - 1);
+    relax(x + 0, y + 1);
+  }
+}
+
+// multi source Dijkstra, every floor tile with a value is a seed
 static void process_dmap(std::vector<float> &map, const DungeonData &dd)
 {
-  bool done = false;
-  auto getMapAt = [&](size_t x, size_t y, float def)
-  {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
-      return map[y * dd.width + x];
-    return def;
-  };
-  auto getMinNei = [&](size_t x, size_t y)
-  {
-    float val = map[y * dd.width + x];
-    val = std::min(val, getMapAt(x - 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 0, y - 1, val));
-    val = std::min(val, getMapAt(x + 0, y + 1, val));
-    return val;
-  };
-  while (!done)
-  {
-    done = true;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-      {
-        const size_t i = y * dd.width + x;
-        if (dd.tiles[i] != dungeon::floor)
-          continue;
-        const float myVal = getMapAt(x, y, invalid_tile_value);
-        const float minVal = getMinNei(x, y);
-        if (minVal < myVal - 1.f)
-        {
-          map[i] = minVal + 1.f;
-          done = false;
-        }
-      }
+  if (dmapKernel == dmaps::DmapKernel::Sweep)
+  {
+    sweep_dmap(map, dd);
+    return;
+  }
+  std::vector<uint32_t> seeds;
+  float minSeed = invalid_tile_value;
+  float maxSeed = -invalid_tile_value;
+  for (size_t i = 0; i < map.size(); ++i)
+    if (dd.tiles[i] == dungeon::floor && map[i] < invalid_tile_value)
+    {
+      seeds.push_back(uint32_t(i));
+      minSeed = std::min(minSeed, map[i]);
+      maxSeed = std::max(maxSeed, map[i]);
+    }
+  if (seeds.empty())
+    return;
+  // buckets have to cover every value from the smallest seed on, most of them would be empty for a wide spread
+  if (maxSeed - minSeed <= float(map.size()))
+  {
+    DmapBuckets queue(minSeed);
+    propagate_dmap(map, dd, seeds, queue);
+  }
+  else
+  {
+    DmapRadixHeap queue(minSeed);
+    propagate_dmap(map, dd, seeds, queue);
   }
 }
 
-void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
+constexpr uint32_t no_source = uint32_t(-1);
+
+// lower wave, seeds already hold their values and every improved tile takes the closest source of its neighbour
+static void lower_dmap(DijkstraMapData &dmap, const DungeonData &dd, const std::vector<uint32_t> &seeds)
 {
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  if (seeds.empty())
+    return;
+  float minSeed = invalid_tile_value;
+  for (uint32_t idx : seeds)
+    minSeed = std::min(minSeed, dmap.map[idx]);
+  DmapBuckets queue(minSeed);
+  for (uint32_t idx : seeds)
+    queue.push(dmap.map[idx], idx);
+  while (!queue.empty())
   {
-    init_tiles(map, dd);
-    query_characters_positions(ecs, [&](const Position &pos, const Team &t)
+    const uint32_t idx = queue.pop();
+    if (dd.tiles[idx] != dungeon::floor)
+      continue;
+    const size_t x = idx % dd.width;
+    const size_t y = idx / dd.width;
+    const float nextVal = dmap.map[idx] + 1.f;
+    auto relax = [&](size_t nx, size_t ny)
     {
-      if (t.team == 0) // player team hardcode
-        map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
-  });
+      if (nx >= dd.width || ny >= dd.height)
+        return;
+      const size_t i = ny * dd.width + nx;
+      if (dd.tiles[i] != dungeon::floor || nextVal >= dmap.map[i])
+        return;
+      dmap.map[i] = nextVal;
+      dmap.nearestSource[i] = dmap.nearestSource[idx];
+      queue.push(nextVal, uint32_t(i));
+    };
+    relax(x - 1, y + 0);
+    relax(x + 1, y + 0);
+    relax(x + 0, y - 1);
+    relax(x + 0, y + 1);
+  }
 }
 
-void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map)
+// sources are tiles with zero distance, when they move only tiles which were closest to removed sources (raise wave)
+// or got closer to added ones (lower wave) are touched, the rest of the previous map stays as it is
+void dmaps::update_dmap(const DungeonData &dd, std::vector<uint32_t> sources, DijkstraMapData &dmap)
 {
-  gen_player_approach_map(ecs, map);
-  for (float &v : map)
-    if (v < invalid_tile_value)
-      v *= -1.2f;
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  if (dmapKernel == DmapKernel::Sweep)
+  {
+    // sweeping doesn't know which source a tile got its value from, so the next update can't be incremental either
+    init_tiles(dmap.map, dd);
+    for (uint32_t idx : sources)
+      dmap.map[idx] = 0.f;
+    sweep_dmap(dmap.map, dd);
+    dmap.sources.clear();
+    dmap.nearestSource.clear();
+    return;
+  }
+  std::sort(sources.begin(), sources.end());
+  sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+  if (dmap.map.size() != dd.width * dd.height || dmap.nearestSource.size() != dmap.map.size())
+  {
+    init_tiles(dmap.map, dd);
+    dmap.nearestSource.assign(dmap.map.size(), no_source);
+    dmap.sources.clear();
+  }
+  std::vector<uint32_t> removed;
+  std::vector<uint32_t> added;
+  std::set_difference(dmap.sources.begin(), dmap.sources.end(), sources.begin(), sources.end(),
+                      std::back_inserter(removed));
+  std::set_difference(sources.begin(), sources.end(), dmap.sources.begin(), dmap.sources.end(),
+                      std::back_inserter(added));
+  // with no source staying put every reachable tile changes, a fresh lower wave is cheaper than raising all of them
+  if (!removed.empty() && removed.size() == dmap.sources.size())
+  {
+    init_tiles(dmap.map, dd);
+    dmap.nearestSource.assign(dmap.map.size(), no_source);
+    removed.clear();
+    added = sources;
+  }
+
+  std::vector<uint32_t> seeds;
+  std::vector<uint32_t> raised = removed;
+  for (uint32_t idx : removed)
   {
-    process_dmap(map, dd);
+    dmap.map[idx] = invalid_tile_value;
+    dmap.nearestSource[idx] = no_source;
+  }
+  for (size_t head = 0; head < raised.size(); ++head)
+  {
+    const size_t x = raised[head] % dd.width;
+    const size_t y = raised[head] / dd.width;
+    // tiles of still valid sources around the raised area are where the lower wave refills it from
+    auto raise = [&](size_t nx, size_t ny)
+    {
+      if (nx >= dd.width || ny >= dd.height)
+        return;
+      const size_t i = ny * dd.width + nx;
+      if (dd.tiles[i] != dungeon::floor)
+        return;
+      if (std::binary_search(removed.begin(), removed.end(), dmap.nearestSource[i]))
+      {
+        dmap.map[i] = invalid_tile_value;
+        dmap.nearestSource[i] = no_source;
+        raised.push_back(uint32_t(i));
+      }
+      else if (dmap.map[i] < invalid_tile_value)
+        seeds.push_back(uint32_t(i));
+    };
+    raise(x - 1, y + 0);
+    raise(x + 1, y + 0);
+    raise(x + 0, y - 1);
+    raise(x + 0, y + 1);
+  }
+  for (uint32_t idx : added)
+  {
+    dmap.map[idx] = 0.f;
+    dmap.nearestSource[idx] = idx;
+    seeds.push_back(idx);
+  }
+  lower_dmap(dmap, dd, seeds);
+  dmap.sources = std::move(sources);
+}
+
+std::vector<uint32_t> dmaps::gather_player_sources(flecs::world &ecs, const DungeonData &dd)
+{
+  std::vector<uint32_t> sources;
+  query_characters_positions(ecs, [&](const Position &pos, const Team &t)
+  {
+    if (t.team == 0) // player team hardcode
+      sources.push_back(uint32_t(pos.y * dd.width + pos.x));
   });
+  return sources;
 }
 
-void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
+std::vector<uint32_t> dmaps::gather_hive_sources(flecs::world &ecs, const DungeonData &dd)
 {
   static auto hiveQuery = ecs.query<const Position, const Hive>();
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  std::vector<uint32_t> sources;
+  hiveQuery.each([&](const Position &pos, const Hive &)
   {
-    init_tiles(map, dd);
-    hiveQuery.each([&](const Position &pos, const Hive &)
-    {
-      map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
+    sources.push_back(uint32_t(pos.y * dd.width + pos.x));
   });
+  return sources;
 }
 
+void dmaps::gen_player_flee_map(const DungeonData &dd, const std::vector<float> &approach_map, std::vector<float> &map)
+{
+  // every tile of the approach map is a seed here, so it's rebuilt as a whole
+  map = approach_map;
+  for (float &v : map)
+    if (v < invalid_tile_value)
+      v *= -1.2f;
+  process_dmap(map, dd);
+}
@@ -1,11 +1,26 @@
 #pragma once
 #include <vector>
+#include <cstdint>
 #include <flecs.h>
+#include "ecsTypes.h"
 
 namespace dmaps
 {
-  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map);
+  enum class DmapKernel
+  {
+    Dijkstra, // bucket queue, incremental updates between turns
+    Sweep // vectorized fast sweeping, same values, maps are rebuilt as a whole every time
+  };
+  // can be switched at any time between turns
+  void set_dmap_kernel(DmapKernel kernel);
+
+  // source tiles are read from ecs on the calling thread, maps are then built without touching ecs
+  // so independent ones can be built on worker threads
+  std::vector<uint32_t> gather_player_sources(flecs::world &ecs, const DungeonData &dd);
+  std::vector<uint32_t> gather_hive_sources(flecs::world &ecs, const DungeonData &dd);
+
+  // keeps dmap from the previous turn and only redoes tiles around sources which moved, appeared or vanished
+  void update_dmap(const DungeonData &dd, std::vector<uint32_t> sources, DijkstraMapData &dmap);
+  void gen_player_flee_map(const DungeonData &dd, const std::vector<float> &approach_map, std::vector<float> &map);
 };
 
@@ -1,37 +1,145 @@
 #include "ecsTypes.h"
 #include "dmapFollower.h"
+#include <algorithm>
 #include <cmath>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
-void process_dmap_followers(flecs::world &ecs)
+constexpr float invalid_tile_value = 1e5f;
+
+struct WeightedDmap
 {
-  static auto processDmapFollowers = ecs.query<const Position, Action, const DmapWeights>();
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  std::vector<std::pair<std::string, DmapWeights::WtData>> weights; // sorted by map name
+  std::vector<float> field;
+};
+
+// there are only a few profiles for all followers, so they are compared one by one
+static std::vector<WeightedDmap> weightedDmaps;
 
-  auto get_dmap_at = [&](const DijkstraMapData &dmap, const DungeonData &dd, size_t x, size_t y, float mult, float pow)
+static size_t intern_weights(const DmapWeights &wt)
+{
+  std::vector<std::pair<std::string, DmapWeights::WtData>> weights(wt.weights.begin(), wt.weights.end());
+  std::sort(weights.begin(), weights.end(), [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
+  auto sameWeights = [&](const WeightedDmap &wd)
   {
-    const float v = dmap.map[y * dd.width + x];
-    if (v < 1e5f)
-      return powf(v * mult, pow);
-    return v;
+    return std::equal(wd.weights.begin(), wd.weights.end(), weights.begin(), weights.end(),
+      [](const auto &lhs, const auto &rhs)
+      {
+        return lhs.first == rhs.first && lhs.second.mult == rhs.second.mult && lhs.second.pow == rhs.second.pow;
+      });
   };
+  auto it = std::find_if(weightedDmaps.begin(), weightedDmaps.end(), sameWeights);
+  if (it != weightedDmaps.end())
+    return size_t(it - weightedDmaps.begin());
+  weightedDmaps.push_back(WeightedDmap{std::move(weights), {}});
+  return weightedDmaps.size() - 1;
+}
+
+static void add_weighted(std::vector<float> &field, const std::vector<float> &map, DmapWeights::WtData wt)
+{
+  if (map.size() != field.size())
+    return;
+  const float *src = map.data();
+  float *dst = field.data();
+  const size_t count = field.size();
+  if (wt.pow != 1.f)
+  {
+    for (size_t i = 0; i < count; ++i)
+      dst[i] += src[i] < invalid_tile_value ? powf(src[i] * wt.mult, wt.pow) : src[i];
+    return;
+  }
+  // most weights are linear, without powf invalid tiles are just scaled by 1 and whole registers are done at once
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 invalid = _mm256_set1_ps(invalid_tile_value);
+  const __m256 mult = _mm256_set1_ps(wt.mult);
+  const __m256 one = _mm256_set1_ps(1.f);
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m256 v = _mm256_loadu_ps(src + i);
+    const __m256 scale = _mm256_blendv_ps(one, mult, _mm256_cmp_ps(v, invalid, _CMP_LT_OQ));
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(v, scale)));
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128 invalid = _mm_set1_ps(invalid_tile_value);
+  const __m128 mult = _mm_set1_ps(wt.mult);
+  const __m128 one = _mm_set1_ps(1.f);
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m128 v = _mm_loadu_ps(src + i);
+    const __m128 valid = _mm_cmplt_ps(v, invalid);
+    const __m128 scale = _mm_or_ps(_mm_and_ps(valid, mult), _mm_andnot_ps(valid, one));
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(v, scale)));
+  }
+#endif
+  for (; i < count; ++i)
+    dst[i] += src[i] * (src[i] < invalid_tile_value ? wt.mult : 1.f);
+}
+
+void compose_weighted_dmaps(flecs::world &ecs)
+{
+  static auto weightsQuery = ecs.query<DmapWeights>();
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+
+  // set() replaces the whole component, so a profile index stays valid until weights change
+  std::vector<bool> used(weightedDmaps.size(), false);
+  weightsQuery.each([&](DmapWeights &wt)
+  {
+    if (wt.profile >= weightedDmaps.size())
+      wt.profile = intern_weights(wt);
+    used.resize(weightedDmaps.size(), false);
+    used[wt.profile] = true;
+  });
   dungeonDataQuery.each([&](const DungeonData &dd)
   {
-    processDmapFollowers.each([&](const Position &pos, Action &act, const DmapWeights &wt)
+    for (size_t i = 0; i < weightedDmaps.size(); ++i)
     {
-      float moveWeights[EA_MOVE_END];
-      for (size_t i = 0; i < EA_MOVE_END; ++i)
-        moveWeights[i] = 0.f;
-      for (const auto &pair : wt.weights)
+      WeightedDmap &wd = weightedDmaps[i];
+      // nobody follows this profile anymore, so its field from an older turn mustn't be found
+      if (!used[i])
       {
+        wd.field.clear();
+        continue;
+      }
+      wd.field.assign(dd.width * dd.height, 0.f);
+      for (const auto &pair : wd.weights)
         ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
         {
-          moveWeights[EA_NOP]         += get_dmap_at(dmap, dd, pos.x+0, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_LEFT]   += get_dmap_at(dmap, dd, pos.x-1, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_RIGHT]  += get_dmap_at(dmap, dd, pos.x+1, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_UP]     += get_dmap_at(dmap, dd, pos.x+0, pos.y-1, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_DOWN]   += get_dmap_at(dmap, dd, pos.x+0, pos.y+1, pair.second.mult, pair.second.pow);
+          add_weighted(wd.field, dmap.map, pair.second);
         });
-      }
+    }
+  });
+}
+
+const std::vector<float> *find_weighted_dmap(const DmapWeights &wt)
+{
+  if (wt.profile >= weightedDmaps.size() || weightedDmaps[wt.profile].field.empty())
+    return nullptr;
+  return &weightedDmaps[wt.profile].field;
+}
+
+void process_dmap_followers(flecs::world &ecs)
+{
+  static auto processDmapFollowers = ecs.query<const Position, Action, const DmapWeights>();
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    processDmapFollowers.each([&](const Position &pos, Action &act, const DmapWeights &wt)
+    {
+      const std::vector<float> *field = find_weighted_dmap(wt);
+      if (!field)
+        return;
+      auto get_dmap_at = [&](size_t x, size_t y) { return (*field)[y * dd.width + x]; };
+      float moveWeights[EA_MOVE_END];
+      moveWeights[EA_NOP]         = get_dmap_at(pos.x+0, pos.y+0);
+      moveWeights[EA_MOVE_LEFT]   = get_dmap_at(pos.x-1, pos.y+0);
+      moveWeights[EA_MOVE_RIGHT]  = get_dmap_at(pos.x+1, pos.y+0);
+      moveWeights[EA_MOVE_UP]     = get_dmap_at(pos.x+0, pos.y-1);
+      moveWeights[EA_MOVE_DOWN]   = get_dmap_at(pos.x+0, pos.y+1);
       float minWt = moveWeights[EA_NOP];
       for (size_t i = 0; i < EA_MOVE_END; ++i)
         if (moveWeights[i] < minWt)
@@ -42,4 +150,3 @@ void process_dmap_followers(flecs::world &ecs)
     });
   });
 }
-
@@ -1,5 +1,12 @@
 #pragma once
+#include <vector>
 #include <flecs.h>
+#include "ecsTypes.h"
 
-void process_dmap_followers(flecs::world &ecs);
+// every distinct DmapWeights profile gets one combined sum(pow(v * mult, pow)) field per turn,
+// call it after maps are regenerated, followers and visualisation only read these fields
+void compose_weighted_dmaps(flecs::world &ecs);
+// nullptr for a profile which wasn't composed yet
+const std::vector<float> *find_weighted_dmap(const DmapWeights &wt);
 
+void process_dmap_followers(flecs::world &ecs);
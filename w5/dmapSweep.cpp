@@ -0,0 +1,155 @@
+#include "dmapSweep.h"
+#include "dungeonUtils.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+constexpr size_t lane_count = 8; // rows are padded to a whole number of AVX registers
+constexpr float wall_value = std::numeric_limits<float>::infinity(); // walls never lower anything around them
+
+// padded rows of values with a mask of floor tiles (all bits set) next to them
+struct SweepGrid
+{
+  size_t rows = 0;
+  size_t stride = 0;
+  std::vector<float> values;
+  std::vector<float> floorMask;
+
+  void resize(size_t num_rows, size_t row_len)
+  {
+    rows = num_rows;
+    stride = (row_len + lane_count - 1) / lane_count * lane_count;
+    values.assign(rows * stride, wall_value);
+    floorMask.assign(rows * stride, 0.f);
+  }
+  float *row(size_t idx) { return values.data() + idx * stride; }
+  const float *mask(size_t idx) const { return floorMask.data() + idx * stride; }
+};
+
+static float all_bits()
+{
+  const uint32_t bits = ~0u;
+  float res;
+  memcpy(&res, &bits, sizeof(res));
+  return res;
+}
+
+// cur = floor ? min(cur, prev + 1) : cur, true if any tile got lower
+static bool relax_row(float *cur, const float *prev, const float *mask, size_t len)
+{
+#if defined(__AVX2__)
+  const __m256 one = _mm256_set1_ps(1.f);
+  __m256 lowered = _mm256_setzero_ps();
+  for (size_t i = 0; i < len; i += 8)
+  {
+    const __m256 c = _mm256_loadu_ps(cur + i);
+    const __m256 m = _mm256_loadu_ps(mask + i);
+    const __m256 r = _mm256_blendv_ps(c, _mm256_min_ps(c, _mm256_add_ps(_mm256_loadu_ps(prev + i), one)), m);
+    lowered = _mm256_or_ps(lowered, _mm256_cmp_ps(r, c, _CMP_LT_OQ));
+    _mm256_storeu_ps(cur + i, r);
+  }
+  return _mm256_movemask_ps(lowered) != 0;
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128 one = _mm_set1_ps(1.f);
+  __m128 lowered = _mm_setzero_ps();
+  for (size_t i = 0; i < len; i += 4)
+  {
+    const __m128 c = _mm_loadu_ps(cur + i);
+    const __m128 m = _mm_loadu_ps(mask + i);
+    const __m128 relaxed = _mm_min_ps(c, _mm_add_ps(_mm_loadu_ps(prev + i), one));
+    const __m128 r = _mm_or_ps(_mm_and_ps(m, relaxed), _mm_andnot_ps(m, c));
+    lowered = _mm_or_ps(lowered, _mm_cmplt_ps(r, c));
+    _mm_storeu_ps(cur + i, r);
+  }
+  return _mm_movemask_ps(lowered) != 0;
+#else
+  bool lowered = false;
+  for (size_t i = 0; i < len; ++i)
+  {
+    const float relaxed = prev[i] + 1.f;
+    uint32_t bits;
+    memcpy(&bits, mask + i, sizeof(bits));
+    if (bits != 0 && relaxed < cur[i])
+    {
+      cur[i] = relaxed;
+      lowered = true;
+    }
+  }
+  return lowered;
+#endif
+}
+
+// along a row the recurrence is sequential anyway, so it's plain code going right and then left
+static void relax_along_row(float *row, const float *mask, size_t len)
+{
+  auto relax = [&](size_t i, size_t from)
+  {
+    uint32_t bits;
+    memcpy(&bits, mask + i, sizeof(bits));
+    const float relaxed = row[from] + 1.f;
+    if (bits != 0 && relaxed < row[i])
+      row[i] = relaxed;
+  };
+  for (size_t i = 1; i < len; ++i)
+    relax(i, i - 1);
+  for (size_t i = len - 1; i > 0; --i)
+    relax(i - 1, i);
+}
+
+// down and then up, a row lowered by its neighbour row spreads new values along itself right away,
+// so one sweep already covers paths which go sideways any number of times
+// rows which weren't lowered are already spread since the first pass over them
+static bool sweep_rows(SweepGrid &grid, size_t width)
+{
+  bool lowered = false;
+  for (size_t y = 1; y < grid.rows; ++y)
+    if (relax_row(grid.row(y), grid.row(y - 1), grid.mask(y), grid.stride))
+    {
+      relax_along_row(grid.row(y), grid.mask(y), width);
+      lowered = true;
+    }
+  for (size_t y = grid.rows - 1; y > 0; --y)
+    if (relax_row(grid.row(y - 1), grid.row(y), grid.mask(y - 1), grid.stride))
+    {
+      relax_along_row(grid.row(y - 1), grid.mask(y - 1), width);
+      lowered = true;
+    }
+  return lowered;
+}
+
+void sweep_dmap(std::vector<float> &map, const DungeonData &dd)
+{
+  if (dd.width == 0 || dd.height == 0)
+    return;
+  // reused between calls, maps are the same size turn after turn
+  static thread_local SweepGrid rows;
+  rows.resize(dd.height, dd.width);
+  const float floorBits = all_bits();
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+    {
+      const size_t i = y * dd.width + x;
+      if (dd.tiles[i] != dungeon::floor)
+        continue;
+      rows.values[y * rows.stride + x] = map[i];
+      rows.floorMask[y * rows.stride + x] = floorBits;
+    }
+
+  for (size_t y = 0; y < rows.rows; ++y)
+    relax_along_row(rows.row(y), rows.mask(y), dd.width);
+  while (sweep_rows(rows, dd.width)) {}
+
+  // walls keep whatever they had, same as with process_dmap
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+    {
+      const size_t i = y * dd.width + x;
+      if (dd.tiles[i] == dungeon::floor)
+        map[i] = rows.values[y * rows.stride + x];
+    }
+}
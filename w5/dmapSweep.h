@@ -0,0 +1,9 @@
+#pragma once
+#include <vector>
+#include "ecsTypes.h"
+
+// fast sweeping alternative to the Dijkstra in process_dmap for unit step costs, gives the very same values
+// rows are swept down and then up, each row is first relaxed from its neighbour row with vector min operations
+// and the wall mask as a blend, then if anything got lower a scalar pass spreads it right and left along the row,
+// sweeps repeat until nothing changes
+void sweep_dmap(std::vector<float> &map, const DungeonData &dd);
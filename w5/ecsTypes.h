@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <cstdint>
 
 // TODO: make a lot of seprate files
 struct Position;
@@ -148,6 +149,9 @@ struct DungeonData
 struct DijkstraMapData
 {
   std::vector<float> map;
+  // for incremental updates, source tiles of the map and the source each tile got its value from
+  std::vector<uint32_t> sources;
+  std::vector<uint32_t> nearestSource;
 };
 
 struct VisualiseMap {};
@@ -160,6 +164,7 @@ struct DmapWeights
     float pow = 1.f;
   };
   std::unordered_map<std::string, WtData> weights;
+  size_t profile = size_t(-1); // interned by compose_weighted_dmaps
 };
 
 struct Hive {};
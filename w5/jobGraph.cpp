@@ -0,0 +1,114 @@
+#include "jobGraph.h"
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace
+{
+  struct GraphRun
+  {
+    std::vector<JobGraph::Job> &jobs;
+    std::vector<size_t> remaining; // unfinished dependencies per job
+    std::deque<size_t> ready;
+    size_t unfinished = 0;
+  };
+
+  // persistent threads, they sleep between graphs and take ready jobs of the current one
+  class WorkerPool
+  {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    GraphRun *current = nullptr;
+    bool quit = false;
+
+    // runs one ready job without the lock and releases its dependants
+    void execute_one(std::unique_lock<std::mutex> &lock)
+    {
+      GraphRun &graph = *current;
+      const size_t id = graph.ready.front();
+      graph.ready.pop_front();
+      lock.unlock();
+      graph.jobs[id].fn();
+      lock.lock();
+      for (size_t dependant : graph.jobs[id].dependants)
+        if (--graph.remaining[dependant] == 0)
+          graph.ready.push_back(dependant);
+      // the caller waits for the graph to finish on the same condition variable
+      if (--graph.unfinished == 0 || !graph.ready.empty())
+        wake.notify_all();
+    }
+
+    void worker_loop()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true)
+      {
+        wake.wait(lock, [&]() { return quit || (current && !current->ready.empty()); });
+        if (quit)
+          return;
+        execute_one(lock);
+      }
+    }
+
+  public:
+    explicit WorkerPool(size_t num_threads)
+    {
+      for (size_t i = 0; i < num_threads; ++i)
+        threads.emplace_back(&WorkerPool::worker_loop, this);
+    }
+
+    ~WorkerPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      wake.notify_all();
+      for (std::thread &thread : threads)
+        thread.join();
+    }
+
+    void run(GraphRun &graph)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      current = &graph;
+      wake.notify_all();
+      while (graph.unfinished > 0)
+      {
+        if (!graph.ready.empty())
+          execute_one(lock);
+        else
+          wake.wait(lock);
+      }
+      current = nullptr;
+    }
+  };
+}
+
+size_t JobGraph::add(std::function<void()> fn, std::initializer_list<size_t> dependencies)
+{
+  const size_t id = jobs.size();
+  jobs.push_back(Job{std::move(fn), {}, dependencies.size()});
+  for (size_t dependency : dependencies)
+    jobs[dependency].dependants.push_back(id);
+  return id;
+}
+
+void JobGraph::run()
+{
+  // the calling thread works too, so one thread less is enough to keep every core busy
+  static WorkerPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+  GraphRun graph{jobs, {}, {}, jobs.size()};
+  graph.remaining.reserve(jobs.size());
+  for (size_t id = 0; id < jobs.size(); ++id)
+  {
+    graph.remaining.push_back(jobs[id].numDependencies);
+    if (jobs[id].numDependencies == 0)
+      graph.ready.push_back(id);
+  }
+  if (graph.unfinished > 0)
+    pool.run(graph);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <initializer_list>
+
+// jobs with dependencies, run() hands every job with finished dependencies to a persistent worker pool
+// and executes jobs on the calling thread as well until the whole graph is done
+class JobGraph
+{
+public:
+  struct Job
+  {
+    std::function<void()> fn;
+    std::vector<size_t> dependants;
+    size_t numDependencies = 0;
+  };
+
+  // dependencies are ids returned by earlier add calls
+  size_t add(std::function<void()> fn, std::initializer_list<size_t> dependencies = {});
+  void run();
+
+private:
+  std::vector<Job> jobs;
+};
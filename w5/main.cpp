@@ -2,10 +2,12 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <cstring>
 #include "ecsTypes.h"
 #include "roguelike.h"
 #include "dungeonGen.h"
 #include "goapPlanner.h"
+#include "dijkstraMapGen.h"
 
 enum EnemyDist
 {
@@ -201,8 +203,12 @@ static void update_camera(Camera2D &cam, flecs::world &ecs)
   });
 }
 
-int main(int /*argc*/, const char ** /*argv*/)
+int main(int argc, const char **argv)
 {
+  for (int i = 1; i < argc; ++i)
+    if (strcmp(argv[i], "--dmap-sweep") == 0)
+      dmaps::set_dmap_kernel(dmaps::DmapKernel::Sweep);
+
   int width = 1920;
   int height = 1080;
   InitWindow(width, height, "w3 AI MIPT");
@@ -0,0 +1,207 @@
+#include "pathDatabase.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cstdio>
+#include <bit>
+
+constexpr uint32_t path_db_magic = 0x31445043; // "CPD1" read as little endian
+constexpr uint32_t path_db_version = 1;
+constexpr uint8_t any_move = 0xf; // walls, unreachable tiles and the source itself fit into any run
+
+struct PathDatabaseHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t tilesHash;
+  uint32_t width, height;
+  uint32_t numRuns;
+};
+
+static uint64_t hash_tiles(const DungeonData &dd)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char tile : dd.tiles)
+    hash = (hash ^ uint8_t(tile)) * 0x100000001b3ull;
+  return hash;
+}
+
+PathDatabase build_path_database(const DungeonData &dd)
+{
+  PathDatabase db;
+  db.width = dd.width;
+  db.height = dd.height;
+  const size_t numTiles = dd.width * dd.height;
+  db.sourceRuns.reserve(numTiles + 1);
+
+  // every target keeps a mask of first moves that start some shortest path to it,
+  // so runs can be kept going whenever one of the moves still fits
+  const int dirs[4][2] = {{-1, 0}, {1, 0}, {0, 1}, {0, -1}}; // in order of EA_MOVE_* starting from EA_MOVE_LEFT
+  std::vector<uint8_t> moves(numTiles);
+  std::vector<int> dist(numTiles);
+  std::vector<size_t> queue;
+  queue.reserve(numTiles);
+  for (size_t source = 0; source < numTiles; ++source)
+  {
+    db.sourceRuns.push_back(uint32_t(db.runs.size()));
+    if (dd.tiles[source] == dungeon::wall)
+      continue;
+    std::fill(moves.begin(), moves.end(), any_move);
+    std::fill(dist.begin(), dist.end(), -1);
+    queue.clear();
+    queue.push_back(source);
+    dist[source] = 0;
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+      const size_t idx = queue[head];
+      const int x = int(idx % dd.width);
+      const int y = int(idx / dd.width);
+      for (int dir = 0; dir < 4; ++dir)
+      {
+        const int nx = x + dirs[dir][0];
+        const int ny = y + dirs[dir][1];
+        if (nx < 0 || ny < 0 || nx >= int(dd.width) || ny >= int(dd.height))
+          continue;
+        const size_t nidx = size_t(ny) * dd.width + size_t(nx);
+        if (dd.tiles[nidx] == dungeon::wall)
+          continue;
+        const uint8_t viaMoves = idx == source ? uint8_t(1 << dir) : moves[idx];
+        if (dist[nidx] < 0)
+        {
+          dist[nidx] = dist[idx] + 1;
+          moves[nidx] = viaMoves;
+          queue.push_back(nidx);
+        }
+        else if (dist[nidx] == dist[idx] + 1)
+          moves[nidx] |= viaMoves;
+      }
+    }
+    moves[source] = any_move;
+
+    // greedy runs, a run lasts while its targets still share a move
+    uint8_t runMoves = 0;
+    for (size_t target = 0; target < numTiles; ++target)
+    {
+      if ((runMoves & moves[target]) != 0)
+      {
+        runMoves &= moves[target];
+        continue;
+      }
+      if (target > 0)
+        db.runs.back() |= uint32_t(EA_MOVE_START + std::countr_zero(runMoves));
+      db.runs.push_back(uint32_t(target) << 3);
+      runMoves = moves[target];
+    }
+    db.runs.back() |= uint32_t(EA_MOVE_START + std::countr_zero(runMoves));
+  }
+  db.sourceRuns.push_back(uint32_t(db.runs.size()));
+  return db;
+}
+
+int first_move(const PathDatabase &db, Position from, Position to)
+{
+  if (from == to || from.x < 0 || from.y < 0 || from.x >= int(db.width) || from.y >= int(db.height) ||
+      to.x < 0 || to.y < 0 || to.x >= int(db.width) || to.y >= int(db.height))
+    return EA_NOP;
+  const size_t source = size_t(from.y) * db.width + size_t(from.x);
+  const uint32_t target = uint32_t(size_t(to.y) * db.width + size_t(to.x));
+  const auto first = db.runs.begin() + db.sourceRuns[source];
+  const auto last = db.runs.begin() + db.sourceRuns[source + 1];
+  if (first == last)
+    return EA_NOP; // wall as a source
+  // last run starting at or before the target
+  const auto run = std::upper_bound(first, last, target, [](uint32_t t, uint32_t r) { return t < (r >> 3); }) - 1;
+  return int(*run & 7);
+}
+
+bool save_path_database(const std::string &path, const DungeonData &dd, const PathDatabase &db)
+{
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    printf("can't write path database '%s'\n", path.c_str());
+    return false;
+  }
+  const PathDatabaseHeader header{path_db_magic, path_db_version, hash_tiles(dd),
+                                  uint32_t(db.width), uint32_t(db.height), uint32_t(db.runs.size())};
+  const bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(db.sourceRuns.data(), sizeof(uint32_t), db.sourceRuns.size(), file) == db.sourceRuns.size() &&
+                       fwrite(db.runs.data(), sizeof(uint32_t), db.runs.size(), file) == db.runs.size();
+  if (fclose(file) != 0 || !written)
+  {
+    printf("can't write path database '%s'\n", path.c_str());
+    remove(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// every source has either no runs or runs starting at target 0 in ascending order, each with a real move,
+// otherwise first_move would read outside of the source runs or return garbage
+static bool runs_valid(const PathDatabase &db)
+{
+  const size_t numTiles = db.width * db.height;
+  if (db.sourceRuns.front() != 0 || db.sourceRuns.back() != db.runs.size() ||
+      !std::is_sorted(db.sourceRuns.begin(), db.sourceRuns.end()))
+    return false;
+  for (size_t source = 0; source < numTiles; ++source)
+  {
+    const uint32_t first = db.sourceRuns[source];
+    const uint32_t last = db.sourceRuns[source + 1];
+    for (uint32_t i = first; i < last; ++i)
+    {
+      const uint32_t target = db.runs[i] >> 3;
+      const uint32_t move = db.runs[i] & 7;
+      if (move < EA_MOVE_START || move >= EA_MOVE_END || target >= numTiles ||
+          (i == first ? target != 0 : target <= db.runs[i - 1] >> 3))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool load_path_database(const std::string &path, const DungeonData &dd, PathDatabase &out_db)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  fseek(file, 0, SEEK_END);
+  const long fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  PathDatabaseHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == path_db_magic &&
+            header.version == path_db_version && header.width == dd.width && header.height == dd.height &&
+            header.tilesHash == hash_tiles(dd);
+  // the run count comes from the file, so it's checked against the file size before anything is allocated
+  const size_t numOffsets = size_t(header.width) * header.height + 1;
+  ok = ok && fileSize >= 0 &&
+       uint64_t(fileSize) == sizeof(header) + (uint64_t(numOffsets) + header.numRuns) * sizeof(uint32_t);
+  PathDatabase db;
+  if (ok)
+  {
+    db.width = header.width;
+    db.height = header.height;
+    db.sourceRuns.resize(numOffsets);
+    db.runs.resize(header.numRuns);
+    ok = fread(db.sourceRuns.data(), sizeof(uint32_t), db.sourceRuns.size(), file) == db.sourceRuns.size() &&
+         fread(db.runs.data(), sizeof(uint32_t), db.runs.size(), file) == db.runs.size();
+  }
+  fclose(file);
+  ok = ok && runs_valid(db);
+  if (!ok)
+  {
+    printf("path database '%s' doesn't match the map, rebuilding\n", path.c_str());
+    return false;
+  }
+  out_db = std::move(db);
+  return true;
+}
+
+PathDatabase load_or_build_path_database(const std::string &path, const DungeonData &dd)
+{
+  PathDatabase db;
+  if (load_path_database(path, dd, db))
+    return db;
+  db = build_path_database(dd);
+  save_path_database(path, dd, db);
+  return db;
+}
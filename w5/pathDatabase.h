@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "ecsTypes.h"
+
+// compressed all pairs first moves (CPD), for every source tile the moves towards all targets
+// in row major order are run length encoded, a query is a binary search over runs of one source
+struct PathDatabase
+{
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<uint32_t> sourceRuns; // per tile offset of its first run, plus one past the last
+  std::vector<uint32_t> runs; // first target index << 3 | move
+};
+
+// one BFS per walkable tile, meant to be done offline or while loading a level
+PathDatabase build_path_database(const DungeonData &dd);
+// next move on a shortest path, EA_NOP for from == to or tiles outside of the map
+// targets which are walls or can't be reached give an arbitrary move
+int first_move(const PathDatabase &db, Position from, Position to);
+
+// the file remembers a hash of the tiles, so loading it for another map fails
+bool save_path_database(const std::string &path, const DungeonData &dd, const PathDatabase &db);
+bool load_path_database(const std::string &path, const DungeonData &dd, PathDatabase &out_db);
+// rebuilds and rewrites the file if it's missing or was made for another map
+PathDatabase load_or_build_path_database(const std::string &path, const DungeonData &dd);
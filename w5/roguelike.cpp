@@ -10,6 +10,8 @@
 #include "dmapFollower.h"
 #include "dmapBeh.h"
 #include "rlikeObjects.h"
+#include "pathDatabase.h"
+#include "jobGraph.h"
 
 
 static void register_roguelike_systems(flecs::world &ecs)
@@ -86,21 +88,13 @@ static void register_roguelike_systems(flecs::world &ecs)
     {
       dungeonDataQuery.each([&](const DungeonData &dd)
       {
+        const std::vector<float> *field = find_weighted_dmap(wt);
+        if (!field)
+          return;
         for (size_t y = 0; y < dd.height; ++y)
           for (size_t x = 0; x < dd.width; ++x)
           {
-            float sum = 0.f;
-            for (const auto &pair : wt.weights)
-            {
-              ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
-              {
-                float v = dmap.map[y * dd.width + x];
-                if (v < 1e5f)
-                  sum += powf(v * pair.second.mult, pair.second.pow);
-                else
-                  sum += v;
-              });
-            }
+            const float sum = (*field)[y * dd.width + x];
             if (sum < 1e5f)
               DrawText(TextFormat("%.1f", sum),
                   int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
@@ -152,9 +146,14 @@ void init_roguelike(flecs::world &ecs)
   ecs.entity("world")
     .set(TurnCounter{})
     .set(ActionLog{});
+
+  // set once, setting it every turn would drop its interned profile
+  ecs.entity("hive_follower_sum")
+    .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}})
+    .add<VisualiseMap>();
 }
 
-void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
+void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h, const std::string &path_db_file)
 {
   flecs::entity wallTex = ecs.entity("wall_tex")
     .set(Texture2D{LoadTexture("assets/wall.png")});
@@ -166,8 +165,13 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
       dungeonData[y * w + x] = tiles[y * w + x];
+  DungeonData dd{dungeonData, w, h};
+  // monsters which only need their next step look it up instead of searching every turn
+  PathDatabase pathDatabase = path_db_file.empty() ? build_path_database(dd)
+                                                   : load_or_build_path_database(path_db_file, dd);
   ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+    .set(std::move(dd))
+    .set(std::move(pathDatabase));
 
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
@@ -354,6 +358,42 @@ static void gather_world_info(flecs::world &ecs)
   });
 }
 
+// maps are built straight in their components, every entity has its component before any pointer is taken
+// so nothing moves in storage while jobs write there
+static void gen_turn_dmaps(flecs::world &ecs)
+{
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  flecs::entity approachMapEntity = ecs.entity("approach_map").add<DijkstraMapData>();
+  flecs::entity fleeMapEntity = ecs.entity("flee_map").add<DijkstraMapData>();
+  flecs::entity hiveMapEntity = ecs.entity("hive_map").add<DijkstraMapData>();
+  DijkstraMapData &approachMap = *approachMapEntity.get_mut<DijkstraMapData>();
+  DijkstraMapData &fleeMap = *fleeMapEntity.get_mut<DijkstraMapData>();
+  DijkstraMapData &hiveMap = *hiveMapEntity.get_mut<DijkstraMapData>();
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    std::vector<uint32_t> playerSources = dmaps::gather_player_sources(ecs, dd);
+    std::vector<uint32_t> hiveSources = dmaps::gather_hive_sources(ecs, dd);
+
+    JobGraph dmapJobs;
+    const size_t approachJob = dmapJobs.add([&]()
+    {
+      dmaps::update_dmap(dd, std::move(playerSources), approachMap);
+    });
+    dmapJobs.add([&]()
+    {
+      dmaps::gen_player_flee_map(dd, approachMap.map, fleeMap.map);
+    }, {approachJob});
+    dmapJobs.add([&]()
+    {
+      dmaps::update_dmap(dd, std::move(hiveSources), hiveMap);
+    });
+    dmapJobs.run();
+  });
+  approachMapEntity.modified<DijkstraMapData>();
+  fleeMapEntity.modified<DijkstraMapData>();
+  hiveMapEntity.modified<DijkstraMapData>();
+}
+
 void process_turn(flecs::world &ecs)
 {
   static auto stateMachineAct = ecs.query<StateMachine>();
@@ -381,25 +421,10 @@ void process_turn(flecs::world &ecs)
     }
     process_actions(ecs);
 
-    std::vector<float> approachMap;
-    dmaps::gen_player_approach_map(ecs, approachMap);
-    ecs.entity("approach_map")
-      .set(DijkstraMapData{approachMap});
-
-    std::vector<float> fleeMap;
-    dmaps::gen_player_flee_map(ecs, fleeMap);
-    ecs.entity("flee_map")
-      .set(DijkstraMapData{fleeMap});
-
-    std::vector<float> hiveMap;
-    dmaps::gen_hive_pack_map(ecs, hiveMap);
-    ecs.entity("hive_map")
-      .set(DijkstraMapData{hiveMap});
+    gen_turn_dmaps(ecs);
 
     //ecs.entity("flee_map").add<VisualiseMap>();
-    ecs.entity("hive_follower_sum")
-      .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}})
-      .add<VisualiseMap>();
+    compose_weighted_dmaps(ecs);
   }
 }
 
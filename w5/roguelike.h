@@ -1,10 +1,13 @@
 #pragma once
 
 #include <flecs.h>
+#include <string>
 
 constexpr float tile_size = 512.f;
 
 void init_roguelike(flecs::world &ecs);
-void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
+// with path_db_file set the path database is loaded from there if it matches the map, and saved there otherwise,
+// only worth it for fixed maps, a map generated anew on every launch never matches
+void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h, const std::string &path_db_file = {});
 void process_turn(flecs::world &ecs);
 void print_stats(flecs::world &ecs);
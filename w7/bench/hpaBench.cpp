@@ -0,0 +1,196 @@
+// headless benchmark for the portal hierarchy, builds it with different level setups over the same map
+// usage:
+//   hpa_bench [--size 2048] [--seed 1] [--queries 500] [--threads 0] [--levels 10,40,160 ...] [--cache file]
+// every --levels is one setup, sizes of clusters in tiles from the finest level to the coarsest
+// with --cache every setup is also built through the nav cache file, once on a miss and once on a hit,
+// and queries run over the data loaded from it
+#include "../dungeonGen.h"
+#include "../dungeonUtils.h"
+#include "../pathfinder.h"
+#include "../navCache.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct BenchSettings
+{
+  size_t size = 2048;
+  unsigned seed = 1;
+  size_t numQueries = 500;
+  size_t numThreads = 0;
+  std::vector<std::vector<size_t>> setups;
+  std::string cachePath;
+};
+
+static std::vector<size_t> parse_sizes(const char *value)
+{
+  std::vector<size_t> sizes;
+  for (char *end = nullptr; *value; value = *end ? end + 1 : end)
+  {
+    sizes.push_back(strtoul(value, &end, 10));
+    if (end == value)
+      return {};
+  }
+  return sizes;
+}
+
+static bool parse_args(int argc, const char **argv, BenchSettings &settings)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *arg = argv[i];
+    if (i + 1 >= argc)
+    {
+      printf("missing value for '%s'\n", arg);
+      return false;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--size") == 0)
+      settings.size = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--seed") == 0)
+      settings.seed = unsigned(strtoul(value, nullptr, 10));
+    else if (strcmp(arg, "--queries") == 0)
+      settings.numQueries = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--threads") == 0)
+      settings.numThreads = strtoul(value, nullptr, 10);
+    else if (strcmp(arg, "--cache") == 0)
+      settings.cachePath = value;
+    else if (strcmp(arg, "--levels") == 0)
+    {
+      settings.setups.push_back(parse_sizes(value));
+      if (settings.setups.back().empty())
+      {
+        printf("bad cluster sizes '%s'\n", value);
+        return false;
+      }
+    }
+    else
+    {
+      printf("unknown argument '%s'\n", arg);
+      return false;
+    }
+  }
+  if (settings.setups.empty())
+    settings.setups = {{10}, {10, 40}, {10, 40, 160}, {10, 20, 80, 320}};
+  return true;
+}
+
+static double ms_since(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, const char **argv)
+{
+  BenchSettings settings;
+  if (!parse_args(argc, argv, settings))
+    return 1;
+
+  const size_t size = settings.size;
+  std::vector<char> tiles(size * size);
+  gen_drunk_dungeon(tiles.data(), size, size, 48, size * size / 200, settings.seed);
+  DungeonData dd{tiles, size, size};
+
+  std::vector<IVec2> floorTiles;
+  for (size_t idx = 0; idx < tiles.size(); ++idx)
+    if (tiles[idx] != dungeon::wall)
+      floorTiles.push_back(IVec2{int(idx % size), int(idx / size)});
+  if (floorTiles.empty())
+  {
+    printf("map has no walkable tiles\n");
+    return 1;
+  }
+  std::mt19937 rng(settings.seed);
+  std::uniform_int_distribution<size_t> tileDist(0, floorTiles.size() - 1);
+  std::vector<std::pair<IVec2, IVec2>> queries;
+  for (size_t i = 0; i < settings.numQueries; ++i)
+    queries.emplace_back(floorTiles[tileDist(rng)], floorTiles[tileDist(rng)]);
+  printf("map %zux%zu, %zu walkable tiles, %zu queries\n", size, size, floorTiles.size(), queries.size());
+
+  struct Row
+  {
+    std::string setup;
+    double buildMs;
+    double cacheMissMs, cacheHitMs;
+    size_t numFound;
+    double searchUs, searchP99Us, refineUs;
+    double pathLength;
+  };
+  std::vector<Row> rows;
+  for (const std::vector<size_t> &setup : settings.setups)
+  {
+    Row row{};
+    for (size_t tilesPerCluster : setup)
+      row.setup += (row.setup.empty() ? "" : ",") + std::to_string(tilesPerCluster);
+
+    const auto buildStart = std::chrono::steady_clock::now();
+    DungeonPortals dp = build_portals(dd, setup.front(), settings.numThreads);
+    build_portal_levels(dd, dp, std::vector<size_t>(setup.begin() + 1, setup.end()), settings.numThreads);
+    row.buildMs = ms_since(buildStart);
+
+    if (!settings.cachePath.empty())
+    {
+      remove(settings.cachePath.c_str());
+      const auto missStart = std::chrono::steady_clock::now();
+      load_or_build_portals(settings.cachePath, dd, setup, settings.numThreads);
+      row.cacheMissMs = ms_since(missStart);
+      const auto hitStart = std::chrono::steady_clock::now();
+      DungeonPortals cached;
+      if (!load_nav_cache(settings.cachePath, dd, setup, cached))
+      {
+        printf("nav cache '%s' wasn't written or can't be read back\n", settings.cachePath.c_str());
+        return 1;
+      }
+      row.cacheHitMs = ms_since(hitStart);
+      // found counts and lengths below then show whether the cached data is the same as a build
+      dp = std::move(cached);
+    }
+
+    // abstract search and tile refinement are timed apart, agents usually refine only a few segments ahead
+    std::vector<double> searchUs;
+    HierarchicalPath path;
+    std::vector<IVec2> pathTiles;
+    for (const auto &[from, to] : queries)
+    {
+      const auto searchStart = std::chrono::steady_clock::now();
+      const bool found = find_path_hierarchical(dd, dp, from, to, path);
+      searchUs.push_back(ms_since(searchStart) * 1e3);
+      if (!found)
+        continue;
+      const auto refineStart = std::chrono::steady_clock::now();
+      pathTiles.clear();
+      while (refine_next_segment(dd, path, pathTiles)) {}
+      row.refineUs += ms_since(refineStart) * 1e3;
+      row.pathLength += double(pathTiles.size());
+      ++row.numFound;
+    }
+    for (double us : searchUs)
+      row.searchUs += us;
+    row.searchUs /= double(std::max(size_t(1), searchUs.size()));
+    std::sort(searchUs.begin(), searchUs.end());
+    row.searchP99Us = searchUs.empty() ? 0.0 : searchUs[std::min(searchUs.size() - 1, searchUs.size() * 99 / 100)];
+    row.refineUs /= double(std::max(size_t(1), row.numFound));
+    row.pathLength /= double(std::max(size_t(1), row.numFound));
+    rows.push_back(row);
+  }
+
+  const bool withCache = !settings.cachePath.empty();
+  printf("%-16s %7s %10s %6s %12s %12s %12s %10s", "levels", "count", "build ms", "found",
+         "search us", "p99 us", "refine us", "length");
+  printf(withCache ? " %10s %10s\n" : "\n", "miss ms", "hit ms");
+  for (const Row &row : rows)
+  {
+    printf("%-16s %7zu %10.2f %6zu %12.2f %12.2f %12.2f %10.1f", row.setup.c_str(),
+           size_t(std::count(row.setup.begin(), row.setup.end(), ',') + 1), row.buildMs, row.numFound,
+           row.searchUs, row.searchP99Us, row.refineUs, row.pathLength);
+    if (withCache)
+      printf(" %10.2f %10.2f", row.cacheMissMs, row.cacheHitMs);
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,327 @@
+#include "dungeonComponents.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+
+static uint32_t find_root(std::vector<uint32_t> &parent, uint32_t v)
+{
+  while (parent[v] != v)
+  {
+    parent[v] = parent[parent[v]];
+    v = parent[v];
+  }
+  return v;
+}
+
+DungeonComponents build_components(const WalkGrid &grid)
+{
+  DungeonComponents dc;
+  dc.labels.assign(grid.width * grid.height, no_component);
+  // first pass labels horizontal runs of walkable tiles, runs are found a word at a time,
+  // a run touching several runs of the previous row joins them in union-find
+  struct Run
+  {
+    size_t from, to; // [from, to)
+    uint32_t label;
+  };
+  std::vector<Run> prevRuns;
+  std::vector<Run> curRuns;
+  std::vector<uint32_t> parent = {no_component};
+  for (size_t y = 0; y < grid.height; ++y)
+  {
+    curRuns.clear();
+    size_t prevRun = 0;
+    for (size_t x = grid.find_next(y, 0, true); x < grid.width; x = grid.find_next(y, x, true))
+    {
+      const size_t end = grid.find_next(y, x, false);
+      uint32_t label = no_component;
+      while (prevRun < prevRuns.size() && prevRuns[prevRun].to <= x)
+        ++prevRun;
+      for (size_t i = prevRun; i < prevRuns.size() && prevRuns[i].from < end; ++i)
+      {
+        const uint32_t root = find_root(parent, prevRuns[i].label);
+        if (label == no_component)
+          label = root;
+        else if (root != label)
+        {
+          parent[std::max(root, label)] = std::min(root, label);
+          label = std::min(root, label);
+        }
+      }
+      if (label == no_component)
+      {
+        label = uint32_t(parent.size());
+        parent.push_back(label);
+      }
+      curRuns.push_back({x, end, label});
+      std::fill_n(dc.labels.begin() + ptrdiff_t(y * grid.width + x), end - x, label);
+      x = end;
+    }
+    std::swap(prevRuns, curRuns);
+  }
+  // second pass makes labels compact
+  std::vector<uint32_t> remap(parent.size(), no_component);
+  dc.sizes = {0};
+  for (uint32_t &label : dc.labels)
+  {
+    if (label == no_component)
+      continue;
+    const uint32_t root = find_root(parent, label);
+    if (remap[root] == no_component)
+    {
+      remap[root] = uint32_t(dc.sizes.size());
+      dc.sizes.push_back(0);
+    }
+    label = remap[root];
+    ++dc.sizes[label];
+  }
+  return dc;
+}
+
+DungeonComponents build_components(const DungeonData &dd)
+{
+  return build_components(build_walk_grid(dd));
+}
+
+static uint32_t alloc_label(DungeonComponents &dc)
+{
+  if (dc.freeLabels.empty())
+  {
+    dc.sizes.push_back(0);
+    return uint32_t(dc.sizes.size() - 1);
+  }
+  const uint32_t label = dc.freeLabels.back();
+  dc.freeLabels.pop_back();
+  return label;
+}
+
+static void free_label(DungeonComponents &dc, uint32_t label)
+{
+  dc.sizes[label] = 0;
+  dc.freeLabels.push_back(label);
+}
+
+template<typename Callable>
+static void for_each_neighbour(const DungeonData &dd, size_t idx, Callable fn)
+{
+  const size_t x = idx % dd.width;
+  const size_t y = idx / dd.width;
+  if (x + 1 < dd.width)
+    fn(idx + 1);
+  if (x > 0)
+    fn(idx - 1);
+  if (y + 1 < dd.height)
+    fn(idx + dd.width);
+  if (y > 0)
+    fn(idx - dd.width);
+}
+
+static void relabel(const DungeonData &dd, DungeonComponents &dc, size_t from_idx, uint32_t new_label)
+{
+  static thread_local std::vector<size_t> queue;
+  const uint32_t oldLabel = dc.labels[from_idx];
+  queue.clear();
+  queue.push_back(from_idx);
+  dc.labels[from_idx] = new_label;
+  for (size_t head = 0; head < queue.size(); ++head)
+    for_each_neighbour(dd, queue[head], [&](size_t nidx)
+    {
+      if (dc.labels[nidx] != oldLabel)
+        return;
+      dc.labels[nidx] = new_label;
+      queue.push_back(nidx);
+    });
+}
+
+static void add_tile(const DungeonData &dd, DungeonComponents &dc, size_t idx)
+{
+  // neighbours get merged into the biggest component
+  uint32_t target = no_component;
+  for_each_neighbour(dd, idx, [&](size_t nidx)
+  {
+    const uint32_t label = dc.labels[nidx];
+    if (label != no_component && (target == no_component || dc.sizes[label] > dc.sizes[target]))
+      target = label;
+  });
+  if (target == no_component)
+    target = alloc_label(dc);
+  dc.labels[idx] = target;
+  ++dc.sizes[target];
+  for_each_neighbour(dd, idx, [&](size_t nidx)
+  {
+    const uint32_t label = dc.labels[nidx];
+    if (label == no_component || label == target)
+      return;
+    dc.sizes[target] += dc.sizes[label];
+    free_label(dc, label);
+    relabel(dd, dc, nidx, target);
+  });
+}
+
+static void remove_tile(const DungeonData &dd, DungeonComponents &dc, size_t idx)
+{
+  const uint32_t label = dc.labels[idx];
+  dc.labels[idx] = no_component;
+  if (--dc.sizes[label] == 0)
+  {
+    free_label(dc, label);
+    return;
+  }
+
+  // walk around the 8 neighbours, orthogonal ones joined through walkable corners can't get disconnected
+  const int x = int(idx % dd.width);
+  const int y = int(idx / dd.width);
+  const int ring[8][2] = {{0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}};
+  auto inComponent = [&](int i)
+  {
+    const int nx = x + ring[i & 7][0];
+    const int ny = y + ring[i & 7][1];
+    return nx >= 0 && ny >= 0 && nx < int(dd.width) && ny < int(dd.height) &&
+           dc.labels[size_t(ny) * dd.width + size_t(nx)] == label;
+  };
+  int start = 0;
+  while (start < 8 && inComponent(start))
+    ++start;
+  if (start == 8)
+    return; // all 8 around are walkable
+  size_t seeds[4];
+  size_t numSeeds = 0;
+  bool segmentHasSeed = false;
+  for (int i = start + 1; i <= start + 8; ++i)
+  {
+    if (!inComponent(i))
+    {
+      segmentHasSeed = false;
+      continue;
+    }
+    if ((i & 1) == 0 && !segmentHasSeed)
+    {
+      seeds[numSeeds++] = size_t(y + ring[i & 7][1]) * dd.width + size_t(x + ring[i & 7][0]);
+      segmentHasSeed = true;
+    }
+  }
+  if (numSeeds <= 1)
+    return;
+
+  // flood from every seed in lockstep until all of them meet or all but one run out of tiles,
+  // so the cost is bound by the smaller parts of the split
+  struct Flood
+  {
+    std::vector<size_t> queue;
+    size_t head = 0;
+    size_t group = 0;
+  };
+  static thread_local Flood floods[4];
+  static thread_local std::vector<uint32_t> visitStamp;
+  static thread_local std::vector<uint8_t> visitOwner;
+  static thread_local uint32_t curStamp = 0;
+  if (visitStamp.size() < dc.labels.size())
+  {
+    visitStamp.resize(dc.labels.size(), 0);
+    visitOwner.resize(dc.labels.size(), 0);
+  }
+  if (++curStamp == 0)
+  {
+    std::fill(visitStamp.begin(), visitStamp.end(), 0);
+    curStamp = 1;
+  }
+  for (size_t i = 0; i < numSeeds; ++i)
+  {
+    floods[i].queue.assign(1, seeds[i]);
+    floods[i].head = 0;
+    floods[i].group = i;
+    visitStamp[seeds[i]] = curStamp;
+    visitOwner[seeds[i]] = uint8_t(i);
+  }
+  auto groupOf = [&](size_t i)
+  {
+    while (floods[i].group != i)
+      i = floods[i].group;
+    return i;
+  };
+  auto groupFinished = [&](size_t group)
+  {
+    for (size_t i = 0; i < numSeeds; ++i)
+      if (groupOf(i) == group && floods[i].head < floods[i].queue.size())
+        return false;
+    return true;
+  };
+  while (true)
+  {
+    size_t numGroups = 0;
+    size_t numRunning = 0;
+    for (size_t i = 0; i < numSeeds; ++i)
+      if (groupOf(i) == i)
+      {
+        ++numGroups;
+        if (!groupFinished(i))
+          ++numRunning;
+      }
+    if (numGroups == 1 || numRunning <= 1)
+      break;
+    for (size_t i = 0; i < numSeeds; ++i)
+    {
+      Flood &flood = floods[i];
+      if (flood.head >= flood.queue.size())
+        continue;
+      for_each_neighbour(dd, flood.queue[flood.head++], [&](size_t nidx)
+      {
+        if (dc.labels[nidx] != label)
+          return;
+        if (visitStamp[nidx] != curStamp)
+        {
+          visitStamp[nidx] = curStamp;
+          visitOwner[nidx] = uint8_t(i);
+          flood.queue.push_back(nidx);
+          return;
+        }
+        const size_t ownGroup = groupOf(i);
+        const size_t otherGroup = groupOf(visitOwner[nidx]);
+        if (ownGroup != otherGroup)
+          floods[std::max(ownGroup, otherGroup)].group = std::min(ownGroup, otherGroup);
+      });
+    }
+  }
+
+  // every finished group is a separate component now, one group keeps the old label
+  size_t keepGroup = numSeeds;
+  for (size_t g = 0; g < numSeeds; ++g)
+    if (groupOf(g) == g && !groupFinished(g))
+      keepGroup = g;
+  if (keepGroup == numSeeds)
+  {
+    // everything got enumerated, keep the old label on the first group
+    keepGroup = groupOf(0);
+  }
+  for (size_t g = 0; g < numSeeds; ++g)
+  {
+    if (groupOf(g) != g || g == keepGroup)
+      continue;
+    const uint32_t newLabel = alloc_label(dc);
+    for (size_t i = 0; i < numSeeds; ++i)
+    {
+      if (groupOf(i) != g)
+        continue;
+      for (size_t tileIdx : floods[i].queue)
+        dc.labels[tileIdx] = newLabel;
+      dc.sizes[newLabel] += floods[i].queue.size();
+      dc.sizes[label] -= floods[i].queue.size();
+    }
+  }
+}
+
+void update_components(const DungeonData &dd, DungeonComponents &dc, const std::vector<IVec2> &changed_tiles)
+{
+  for (const IVec2 &tile : changed_tiles)
+  {
+    if (tile.x < 0 || tile.y < 0 || tile.x >= int(dd.width) || tile.y >= int(dd.height))
+      continue;
+    const size_t idx = size_t(tile.y) * dd.width + size_t(tile.x);
+    const bool walkable = dd.tiles[idx] != dungeon::wall;
+    if (walkable == (dc.labels[idx] != no_component))
+      continue;
+    if (walkable)
+      add_tile(dd, dc, idx);
+    else
+      remove_tile(dd, dc, idx);
+  }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "ecsTypes.h"
+#include "math.h"
+#include "walkGrid.h"
+
+constexpr uint32_t no_component = 0;
+
+// connected areas of walkable tiles, used to reject queries without a path before any search
+struct DungeonComponents
+{
+  std::vector<uint32_t> labels; // per tile, no_component for walls
+  std::vector<size_t> sizes; // tiles per label
+  std::vector<uint32_t> freeLabels;
+};
+
+DungeonComponents build_components(const DungeonData &dd);
+DungeonComponents build_components(const WalkGrid &grid);
+// dd must already contain the edits
+void update_components(const DungeonData &dd, DungeonComponents &dc, const std::vector<IVec2> &changed_tiles);
+
+inline bool same_component(const DungeonData &dd, const DungeonComponents &dc, IVec2 a, IVec2 b)
+{
+  if (a.x < 0 || a.y < 0 || a.x >= int(dd.width) || a.y >= int(dd.height) ||
+      b.x < 0 || b.y < 0 || b.x >= int(dd.width) || b.y >= int(dd.height))
+    return false;
+  const uint32_t label = dc.labels[size_t(a.y) * dd.width + size_t(a.x)];
+  return label != no_component && label == dc.labels[size_t(b.y) * dd.width + size_t(b.x)];
+}
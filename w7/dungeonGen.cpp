@@ -9,7 +9,7 @@
 #include "math.h"
 #include <limits>
 
-void gen_drunk_dungeon(char *tiles, size_t w, size_t h)
+void gen_drunk_dungeon(char *tiles, size_t w, size_t h, size_t num_iter, size_t max_excavations, unsigned seed)
 {
   //constexpr char wall = '#';
   //constexpr char flr = ' ';
@@ -17,7 +17,6 @@ void gen_drunk_dungeon(char *tiles, size_t w, size_t h)
   memset(tiles, dungeon::wall, w * h);
 
   // generator
-  unsigned seed = unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
   std::default_random_engine seedGenerator(seed);
   std::default_random_engine widthGenerator(seedGenerator());
   std::default_random_engine heightGenerator(seedGenerator());
@@ -33,17 +32,15 @@ void gen_drunk_dungeon(char *tiles, size_t w, size_t h)
 
   const int dirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
 
-  constexpr size_t numIter = 4;
-  constexpr size_t maxExcavations = 200;
   std::vector<IVec2> startPos;
-  for (size_t iter = 0; iter < numIter; ++iter)
+  for (size_t iter = 0; iter < num_iter; ++iter)
   {
     // select random point on map
     size_t x = rndWd();
     size_t y = rndHt();
     startPos.push_back({int(x), int(y)});
     size_t numExcavations = 0;
-    while (numExcavations < maxExcavations)
+    while (numExcavations < max_excavations)
     {
       if (tiles[y * w + x] == dungeon::wall)
       {
@@ -74,6 +71,12 @@ void gen_drunk_dungeon(char *tiles, size_t w, size_t h)
         tiles[size_t(pos.y) * w + size_t(pos.x)] = dungeon::floor;
       }
     }
+}
+
+void gen_drunk_dungeon(char *tiles, size_t w, size_t h)
+{
+  unsigned seed = unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
+  gen_drunk_dungeon(tiles, w, h, 4, 200, seed);
 
   for (size_t y = 0; y < h; ++y)
     printf("%.*s\n", int(w), tiles + y * w);
@@ -2,3 +2,5 @@
 #include <cstddef> // size_t
 
 void gen_drunk_dungeon(char *tiles, size_t w, size_t h);
+// deterministic for the seed and quiet, for benchmarks
+void gen_drunk_dungeon(char *tiles, size_t w, size_t h, size_t num_iter, size_t max_excavations, unsigned seed);
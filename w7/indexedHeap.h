@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// binary min-heap over node indices with decrease-key support
+// nodes are tile indices in [0, capacity)
+class IndexedHeap
+{
+  struct Entry
+  {
+    float key;
+    size_t node;
+  };
+  std::vector<Entry> heap;
+  std::vector<size_t> heapIdx; // node -> position in heap, valid only while node is in heap
+
+  void place(size_t i, const Entry &e)
+  {
+    heap[i] = e;
+    heapIdx[e.node] = i;
+  }
+
+  void sift_up(size_t i)
+  {
+    const Entry e = heap[i];
+    while (i > 0)
+    {
+      const size_t parent = (i - 1) / 2;
+      if (heap[parent].key <= e.key)
+        break;
+      place(i, heap[parent]);
+      i = parent;
+    }
+    place(i, e);
+  }
+
+  void sift_down(size_t i)
+  {
+    const Entry e = heap[i];
+    const size_t count = heap.size();
+    while (true)
+    {
+      size_t child = i * 2 + 1;
+      if (child >= count)
+        break;
+      if (child + 1 < count && heap[child + 1].key < heap[child].key)
+        ++child;
+      if (e.key <= heap[child].key)
+        break;
+      place(i, heap[child]);
+      i = child;
+    }
+    place(i, e);
+  }
+
+public:
+  void reset(size_t capacity)
+  {
+    heap.clear();
+    if (heapIdx.size() < capacity)
+      heapIdx.resize(capacity);
+  }
+
+  bool empty() const { return heap.empty(); }
+  size_t size() const { return heap.size(); }
+  float top_key() const { return heap.front().key; }
+  size_t top() const { return heap.front().node; }
+
+  void push(size_t node, float key)
+  {
+    heap.push_back({key, node});
+    sift_up(heap.size() - 1);
+  }
+
+  // caller guarantees node is in the heap and key is not greater than the current one
+  void decrease_key(size_t node, float key)
+  {
+    const size_t i = heapIdx[node];
+    heap[i].key = key;
+    sift_up(i);
+  }
+
+  size_t pop()
+  {
+    const size_t node = heap.front().node;
+    const Entry last = heap.back();
+    heap.pop_back();
+    if (!heap.empty())
+    {
+      heap.front() = last;
+      sift_down(0);
+    }
+    return node;
+  }
+};
@@ -0,0 +1,474 @@
+#include "navCache.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <filesystem>
+#if defined(__unix__) || defined(__APPLE__)
+#define NAV_CACHE_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#define NAV_CACHE_MMAP 0
+#endif
+
+constexpr uint32_t nav_cache_magic = 0x4356414e; // "NAVC" read as little endian
+constexpr uint32_t nav_cache_version = 1; // bump on any change of the layout below
+
+struct NavCacheHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint64_t payloadSize;
+  uint64_t payloadHash;
+};
+
+// fixed width mirrors of the in-memory types
+struct PackedPortal
+{
+  uint32_t startX, startY;
+  uint32_t endX, endY;
+};
+
+struct PackedConnection
+{
+  uint32_t connIdx;
+  float score;
+  uint32_t cluster;
+};
+
+// word at a time, the payload can be tens of megabytes
+static uint64_t hash_bytes(const void *data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  constexpr uint64_t prime = 0x100000001b3ull;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * prime;
+    hash ^= hash >> 29;
+  }
+  for (; i < size; ++i)
+    hash = (hash ^ bytes[i]) * prime;
+  return hash;
+}
+
+uint64_t nav_cache_key(const DungeonData &dd, const std::vector<size_t> &cluster_tiles)
+{
+  uint64_t hash = hash_bytes(dd.tiles.data(), dd.tiles.size());
+  const uint64_t dims[2] = {dd.width, dd.height};
+  hash = hash_bytes(dims, sizeof(dims), hash);
+  for (size_t tiles : cluster_tiles)
+  {
+    const uint64_t value = tiles;
+    hash = hash_bytes(&value, sizeof(value), hash);
+  }
+  return hash;
+}
+
+struct BlobWriter
+{
+  std::vector<uint8_t> bytes;
+
+  void put_raw(const void *data, size_t size)
+  {
+    const uint8_t *from = static_cast<const uint8_t *>(data);
+    bytes.insert(bytes.end(), from, from + size);
+  }
+
+  template<typename T>
+  void put(const T &value) { put_raw(&value, sizeof(T)); }
+
+  // sizes are stored as 64 bit whatever size_t is
+  void put_size(size_t value)
+  {
+    const uint64_t stored = value;
+    put(stored);
+  }
+
+  template<typename T>
+  void put_array(const std::vector<T> &values)
+  {
+    put_size(values.size());
+    put_raw(values.data(), values.size() * sizeof(T));
+  }
+
+  // offsets first, then all items back to back
+  template<typename T, typename Packer>
+  void put_lists(const std::vector<std::vector<T>> &lists, Packer pack)
+  {
+    std::vector<uint32_t> offsets(1, 0);
+    for (const std::vector<T> &list : lists)
+      offsets.push_back(offsets.back() + uint32_t(list.size()));
+    put_array(offsets);
+    put(uint64_t(offsets.back()));
+    for (const std::vector<T> &list : lists)
+      for (const T &item : list)
+        put(pack(item));
+  }
+};
+
+// every read is bounds checked, a failed one leaves the reader in the failed state
+struct BlobReader
+{
+  const uint8_t *cur;
+  const uint8_t *end;
+  bool ok = true;
+
+  bool get_raw(void *data, size_t size)
+  {
+    if (!ok || size_t(end - cur) < size)
+      return ok = false;
+    memcpy(data, cur, size);
+    cur += size;
+    return true;
+  }
+
+  template<typename T>
+  bool get(T &value) { return get_raw(&value, sizeof(T)); }
+
+  template<typename T>
+  bool get_array(std::vector<T> &values)
+  {
+    uint64_t count = 0;
+    if (!get(count) || count > size_t(end - cur) / sizeof(T))
+      return ok = false;
+    values.resize(count);
+    return get_raw(values.data(), count * sizeof(T));
+  }
+
+  template<typename T, typename Packed, typename Unpacker>
+  bool get_lists(std::vector<std::vector<T>> &lists, Unpacker unpack)
+  {
+    static thread_local std::vector<uint32_t> offsets;
+    uint64_t numItems = 0;
+    if (!get_array(offsets) || offsets.empty() || !get(numItems) || offsets.back() != numItems ||
+        numItems > size_t(end - cur) / sizeof(Packed))
+      return ok = false;
+    lists.resize(offsets.size() - 1);
+    const uint8_t *items = cur;
+    for (size_t i = 0; i + 1 < offsets.size(); ++i)
+    {
+      if (offsets[i] > offsets[i + 1])
+        return ok = false;
+      lists[i].resize(offsets[i + 1] - offsets[i]);
+      for (size_t j = 0; j < lists[i].size(); ++j)
+      {
+        Packed packed;
+        memcpy(&packed, items + (offsets[i] + j) * sizeof(Packed), sizeof(Packed));
+        lists[i][j] = unpack(packed);
+      }
+    }
+    cur += numItems * sizeof(Packed);
+    return true;
+  }
+};
+
+static PackedConnection pack_connection(const PortalConnection &conn)
+{
+  return PackedConnection{uint32_t(conn.connIdx), conn.score, uint32_t(conn.cluster)};
+}
+
+static PortalConnection unpack_connection(const PackedConnection &packed)
+{
+  return PortalConnection{packed.connIdx, packed.score, packed.cluster};
+}
+
+static void write_payload(const DungeonPortals &dp, BlobWriter &writer)
+{
+  writer.put_size(dp.tileSplit);
+  std::vector<PackedPortal> portals;
+  portals.reserve(dp.portals.size());
+  std::vector<std::vector<PortalConnection>> conns;
+  conns.reserve(dp.portals.size());
+  for (const PathPortal &portal : dp.portals)
+  {
+    portals.push_back({uint32_t(portal.startX), uint32_t(portal.startY), uint32_t(portal.endX), uint32_t(portal.endY)});
+    conns.push_back(portal.conns);
+  }
+  writer.put_array(portals);
+  writer.put_lists(conns, pack_connection);
+  writer.put_lists(dp.tilePortalsIndices, [](size_t idx) { return uint32_t(idx); });
+
+  writer.put_array(dp.components.labels);
+  std::vector<uint64_t> sizes(dp.components.sizes.begin(), dp.components.sizes.end());
+  writer.put_array(sizes);
+  writer.put_array(dp.components.freeLabels);
+
+  writer.put_size(dp.walkGrid.width);
+  writer.put_size(dp.walkGrid.height);
+  writer.put_size(dp.walkGrid.wordsPerRow);
+  writer.put_array(dp.walkGrid.bits);
+
+  writer.put_size(dp.levels.size());
+  for (const PortalLevel &pl : dp.levels)
+  {
+    writer.put_size(pl.clusterRatio);
+    writer.put_size(pl.width);
+    writer.put_size(pl.height);
+    writer.put_lists(pl.clusterPortals, [](size_t idx) { return uint32_t(idx); });
+    writer.put_lists(pl.conns, pack_connection);
+  }
+}
+
+// indices read from the file are used without checks later on, so they have to point into what was loaded
+static bool indices_below(const std::vector<std::vector<size_t>> &lists, size_t limit)
+{
+  for (const std::vector<size_t> &list : lists)
+    for (size_t idx : list)
+      if (idx >= limit)
+        return false;
+  return true;
+}
+
+static bool connections_valid(const std::vector<PortalConnection> &conns, size_t num_portals, size_t num_clusters)
+{
+  for (const PortalConnection &conn : conns)
+    if (conn.connIdx >= num_portals || conn.cluster >= num_clusters)
+      return false;
+  return true;
+}
+
+static bool read_payload(const DungeonData &dd, BlobReader &reader, DungeonPortals &dp)
+{
+  uint64_t tileSplit = 0;
+  if (!reader.get(tileSplit) || tileSplit == 0)
+    return false;
+  dp.tileSplit = tileSplit;
+  std::vector<PackedPortal> portals;
+  std::vector<std::vector<PortalConnection>> conns;
+  if (!reader.get_array(portals) ||
+      !reader.get_lists<PortalConnection, PackedConnection>(conns, unpack_connection) ||
+      conns.size() != portals.size())
+    return false;
+  dp.portals.resize(portals.size());
+  for (size_t i = 0; i < portals.size(); ++i)
+  {
+    const PackedPortal &packed = portals[i];
+    if (packed.startX > packed.endX || packed.startY > packed.endY || packed.endX >= dd.width || packed.endY >= dd.height)
+      return false;
+    dp.portals[i] = PathPortal{packed.startX, packed.startY, packed.endX, packed.endY, std::move(conns[i])};
+  }
+  auto unpackIndex = [](uint32_t idx) { return size_t(idx); };
+  const size_t numClusters = (dd.width / tileSplit) * (dd.height / tileSplit);
+  if (!reader.get_lists<size_t, uint32_t>(dp.tilePortalsIndices, unpackIndex) ||
+      dp.tilePortalsIndices.size() != numClusters || !indices_below(dp.tilePortalsIndices, dp.portals.size()))
+    return false;
+  for (const PathPortal &portal : dp.portals)
+    if (!connections_valid(portal.conns, dp.portals.size(), numClusters))
+      return false;
+
+  std::vector<uint64_t> sizes;
+  if (!reader.get_array(dp.components.labels) || !reader.get_array(sizes) ||
+      !reader.get_array(dp.components.freeLabels) || dp.components.labels.size() != dd.width * dd.height)
+    return false;
+  dp.components.sizes.assign(sizes.begin(), sizes.end());
+  for (uint32_t label : dp.components.labels)
+    if (label >= sizes.size())
+      return false;
+  for (uint32_t label : dp.components.freeLabels)
+    if (label == no_component || label >= sizes.size())
+      return false;
+
+  uint64_t gridWidth = 0, gridHeight = 0, wordsPerRow = 0;
+  if (!reader.get(gridWidth) || !reader.get(gridHeight) || !reader.get(wordsPerRow) ||
+      !reader.get_array(dp.walkGrid.bits) || gridWidth != dd.width || gridHeight != dd.height ||
+      wordsPerRow != (gridWidth + 63) / 64 || dp.walkGrid.bits.size() != wordsPerRow * gridHeight)
+    return false;
+  dp.walkGrid.width = gridWidth;
+  dp.walkGrid.height = gridHeight;
+  dp.walkGrid.wordsPerRow = wordsPerRow;
+
+  uint64_t numLevels = 0;
+  if (!reader.get(numLevels) || numLevels > 64)
+    return false;
+  dp.levels.resize(numLevels);
+  size_t childWidth = dd.width / tileSplit;
+  size_t childHeight = dd.height / tileSplit;
+  for (PortalLevel &pl : dp.levels)
+  {
+    uint64_t ratio = 0, width = 0, height = 0;
+    if (!reader.get(ratio) || !reader.get(width) || !reader.get(height) || ratio < 2 ||
+        width != (childWidth + ratio - 1) / ratio || height != (childHeight + ratio - 1) / ratio ||
+        !reader.get_lists<size_t, uint32_t>(pl.clusterPortals, unpackIndex) ||
+        !reader.get_lists<PortalConnection, PackedConnection>(pl.conns, unpack_connection) ||
+        pl.clusterPortals.size() != width * height || pl.conns.size() != dp.portals.size() ||
+        !indices_below(pl.clusterPortals, dp.portals.size()))
+      return false;
+    for (const std::vector<PortalConnection> &conns : pl.conns)
+      if (!connections_valid(conns, dp.portals.size(), width * height))
+        return false;
+    pl.clusterRatio = ratio;
+    pl.width = width;
+    pl.height = height;
+    childWidth = width;
+    childHeight = height;
+  }
+  return reader.ok && reader.cur == reader.end;
+}
+
+// read only view of a whole file, mapped where possible and read into memory otherwise
+class MappedFile
+{
+  const uint8_t *bytes = nullptr;
+  size_t fileSize = 0;
+  std::vector<uint8_t> buffer;
+#if NAV_CACHE_MMAP
+  void *mapping = nullptr;
+#endif
+
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile()
+  {
+#if NAV_CACHE_MMAP
+    if (mapping)
+      munmap(mapping, fileSize);
+#endif
+  }
+
+  bool open(const std::string &path)
+  {
+#if NAV_CACHE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+        void *ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
+        {
+          mapping = ptr;
+          bytes = static_cast<const uint8_t *>(ptr);
+          fileSize = size_t(st.st_size);
+        }
+      }
+      ::close(fd);
+      if (mapping)
+        return true;
+    }
+#endif
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+      return false;
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size > 0)
+    {
+      buffer.resize(size_t(size));
+      if (fread(buffer.data(), 1, buffer.size(), file) != buffer.size())
+        buffer.clear();
+    }
+    fclose(file);
+    bytes = buffer.data();
+    fileSize = buffer.size();
+    return fileSize > 0;
+  }
+
+  const uint8_t *data() const { return bytes; }
+  size_t size() const { return fileSize; }
+};
+
+bool load_nav_cache(const std::string &path, const DungeonData &dd, const std::vector<size_t> &cluster_tiles,
+                    DungeonPortals &out_portals)
+{
+  MappedFile file;
+  if (!file.open(path))
+    return false;
+  NavCacheHeader header;
+  if (file.size() < sizeof(header))
+  {
+    printf("nav cache '%s' is truncated\n", path.c_str());
+    return false;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != nav_cache_magic || header.version != nav_cache_version)
+  {
+    printf("nav cache '%s' has an unknown format\n", path.c_str());
+    return false;
+  }
+  if (header.key != nav_cache_key(dd, cluster_tiles))
+  {
+    printf("nav cache '%s' is stale\n", path.c_str());
+    return false;
+  }
+  const uint8_t *payload = file.data() + sizeof(header);
+  if (header.payloadSize != file.size() - sizeof(header) ||
+      header.payloadHash != hash_bytes(payload, header.payloadSize))
+  {
+    printf("nav cache '%s' is corrupted\n", path.c_str());
+    return false;
+  }
+  BlobReader reader{payload, payload + header.payloadSize};
+  DungeonPortals dp;
+  if (!read_payload(dd, reader, dp))
+  {
+    printf("nav cache '%s' has inconsistent data\n", path.c_str());
+    return false;
+  }
+  out_portals = std::move(dp);
+  return true;
+}
+
+bool save_nav_cache(const std::string &path, const DungeonData &dd, const std::vector<size_t> &cluster_tiles,
+                    const DungeonPortals &dp)
+{
+  BlobWriter payload;
+  write_payload(dp, payload);
+  const NavCacheHeader header{nav_cache_magic, nav_cache_version, nav_cache_key(dd, cluster_tiles),
+                              payload.bytes.size(), hash_bytes(payload.bytes.data(), payload.bytes.size())};
+  const std::string tmpPath = path + ".tmp";
+  FILE *file = fopen(tmpPath.c_str(), "wb");
+  if (!file)
+  {
+    printf("can't write nav cache '%s'\n", tmpPath.c_str());
+    return false;
+  }
+  const bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(payload.bytes.data(), 1, payload.bytes.size(), file) == payload.bytes.size();
+  if (fclose(file) != 0 || !written)
+  {
+    printf("can't write nav cache '%s'\n", tmpPath.c_str());
+    remove(tmpPath.c_str());
+    return false;
+  }
+  // replaces the old cache in one step, readers see either the old file or the new one
+  std::error_code error;
+  std::filesystem::rename(tmpPath, path, error);
+  if (error)
+  {
+    printf("can't move nav cache to '%s'\n", path.c_str());
+    remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+DungeonPortals load_or_build_portals(const std::string &path, const DungeonData &dd,
+                                     const std::vector<size_t> &cluster_tiles, size_t num_threads,
+                                     PortalBuildStats *stats)
+{
+  const auto startTime = std::chrono::steady_clock::now();
+  DungeonPortals dp;
+  if (load_nav_cache(path, dd, cluster_tiles, dp))
+  {
+    printf("nav cache: loaded '%s' in %.3f ms\n", path.c_str(),
+           std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+    return dp;
+  }
+  const size_t splitTiles = cluster_tiles.empty() ? 10 : cluster_tiles.front();
+  dp = build_portals(dd, splitTiles, num_threads, stats);
+  build_portal_levels(dd, dp, std::vector<size_t>(cluster_tiles.begin() + (cluster_tiles.empty() ? 0 : 1),
+                                                  cluster_tiles.end()), num_threads, stats);
+  save_nav_cache(path, dd, cluster_tiles, dp);
+  return dp;
+}
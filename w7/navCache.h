@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "ecsTypes.h"
+#include "pathfinder.h"
+
+// versioned binary blob with everything build_portals and build_portal_levels produce
+// the key covers tiles, size and cluster sizes, so a cache of another map or setup is never used
+uint64_t nav_cache_key(const DungeonData &dd, const std::vector<size_t> &cluster_tiles);
+
+// maps the file and copies arrays out of it, false if it's missing, stale or corrupted
+bool load_nav_cache(const std::string &path, const DungeonData &dd, const std::vector<size_t> &cluster_tiles,
+                    DungeonPortals &out_portals);
+// written into a temporary file first, so a crash can't leave a half written cache behind
+bool save_nav_cache(const std::string &path, const DungeonData &dd, const std::vector<size_t> &cluster_tiles,
+                    const DungeonPortals &dp);
+
+// cluster_tiles are as in prebuild_map, rebuilds and rewrites the cache on a miss
+// stats are filled only by a rebuild
+DungeonPortals load_or_build_portals(const std::string &path, const DungeonData &dd,
+                                     const std::vector<size_t> &cluster_tiles, size_t num_threads = 0,
+                                     PortalBuildStats *stats = nullptr);
@@ -0,0 +1,198 @@
+#include "pathRequests.h"
+#include "pathfinder.h"
+#include "ecsTypes.h"
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+  // persistent threads which run the same job together with the caller thread
+  class WorkerPool
+  {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void()> job;
+    size_t jobId = 0;
+    size_t busy = 0;
+    bool quit = false;
+
+    void worker_loop()
+    {
+      size_t lastJob = 0;
+      while (true)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          wake.wait(lock, [&]() { return quit || jobId != lastJob; });
+          if (quit)
+            return;
+          lastJob = jobId;
+        }
+        job();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0)
+          done.notify_one();
+      }
+    }
+
+  public:
+    explicit WorkerPool(size_t num_threads)
+    {
+      for (size_t i = 0; i < num_threads; ++i)
+        threads.emplace_back(&WorkerPool::worker_loop, this);
+    }
+
+    ~WorkerPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      wake.notify_all();
+      for (std::thread &thread : threads)
+        thread.join();
+    }
+
+    void run(const std::function<void()> &fn)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = fn;
+        busy = threads.size();
+        ++jobId;
+      }
+      wake.notify_all();
+      fn();
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [&]() { return busy == 0; });
+    }
+  };
+
+  struct QueuedRequest
+  {
+    flecs::entity agent;
+    PathRequest request;
+    uint32_t serial;
+    Clock::time_point queuedAt;
+  };
+
+  struct PathScheduler
+  {
+    PathSchedulerSettings settings;
+    std::unique_ptr<WorkerPool> pool;
+    std::deque<QueuedRequest> queue;
+    std::unordered_map<uint64_t, uint32_t> latestSerial; // newer request for the same agent discards older ones
+    uint32_t nextSerial = 0;
+
+    std::vector<QueuedRequest> batch;
+    std::vector<std::vector<IVec2>> batchPaths;
+    std::vector<char> batchDone;
+  };
+
+  // lives on an entity of the world, so the workers are joined when the world is destroyed
+  struct PathSchedulerHolder
+  {
+    std::shared_ptr<PathScheduler> sched;
+  };
+}
+
+static void process_request(const DungeonData &dd, const DungeonPortals &dp, const PathRequest &req,
+                            std::vector<IVec2> &out_path)
+{
+  out_path.clear();
+  HierarchicalPath path;
+  if (!find_path_hierarchical(dd, dp, req.from, req.to, path))
+    return;
+  while (refine_next_segment(dd, path, out_path)) {}
+  if (!path.valid)
+    out_path.clear();
+}
+
+static void process_frame(PathScheduler &sched, const DungeonData &dd, const DungeonPortals &dp)
+{
+  if (sched.queue.empty())
+    return;
+  const Clock::time_point frameStart = Clock::now();
+  const Clock::time_point deadline =
+    frameStart + std::chrono::microseconds(int64_t(sched.settings.frameBudgetUs));
+
+  // everything queued is offered to the workers, whatever doesn't fit into the budget goes back
+  sched.batch.assign(sched.queue.begin(), sched.queue.end());
+  sched.queue.clear();
+  const size_t count = sched.batch.size();
+  if (sched.batchPaths.size() < count)
+    sched.batchPaths.resize(count);
+  sched.batchDone.assign(count, 0);
+
+  std::atomic<size_t> next{0};
+  auto work = [&]()
+  {
+    while (Clock::now() < deadline)
+    {
+      const size_t i = next.fetch_add(1);
+      if (i >= count)
+        return;
+      process_request(dd, dp, sched.batch[i].request, sched.batchPaths[i]);
+      sched.batchDone[i] = 1;
+    }
+  };
+  if (sched.pool)
+    sched.pool->run(work);
+  else
+    work();
+
+  const Clock::time_point now = Clock::now();
+  for (size_t i = 0; i < count; ++i)
+  {
+    QueuedRequest &item = sched.batch[i];
+    if (!sched.batchDone[i])
+    {
+      sched.queue.push_back(item);
+      continue;
+    }
+    auto it = sched.latestSerial.find(item.agent.id());
+    if (it == sched.latestSerial.end() || it->second != item.serial)
+      continue; // superseded by a newer request
+    sched.latestSerial.erase(it);
+    if (!item.agent.is_alive())
+      continue;
+    item.agent.set(PathResult{std::move(sched.batchPaths[i]),
+                              std::chrono::duration<float>(now - item.queuedAt).count()});
+  }
+}
+
+void register_path_request_systems(flecs::world &ecs, const PathSchedulerSettings &settings)
+{
+  std::shared_ptr<PathScheduler> holder = std::make_shared<PathScheduler>();
+  holder->settings = settings;
+  holder->pool = settings.numThreads > 0 ? std::make_unique<WorkerPool>(settings.numThreads) : nullptr;
+  // systems below are destroyed together with the world as well, so they can keep a plain pointer
+  PathScheduler *sched = holder.get();
+  ecs.entity("path_scheduler").set(PathSchedulerHolder{std::move(holder)});
+
+  ecs.system<const PathRequest>()
+    .each([sched](flecs::entity e, const PathRequest &req)
+    {
+      const uint32_t serial = sched->nextSerial++;
+      sched->latestSerial[e.id()] = serial;
+      sched->queue.push_back({e, req, serial, Clock::now()});
+      e.remove<PathRequest>();
+    });
+
+  ecs.system<const DungeonData, const DungeonPortals>()
+    .each([sched](const DungeonData &dd, const DungeonPortals &dp)
+    {
+      process_frame(*sched, dd, dp);
+    });
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include "math.h"
+
+// add to an agent to ask for a path, it's consumed by the scheduler and PathResult is set later
+struct PathRequest
+{
+  IVec2 from;
+  IVec2 to;
+};
+
+struct PathResult
+{
+  std::vector<IVec2> path; // empty if there's no path
+  float waitTime = 0.f; // seconds between request and result
+};
+
+struct PathSchedulerSettings
+{
+  size_t numThreads = 0; // extra workers on top of the main thread, 0 keeps everything on the main thread
+  float frameBudgetUs = 2000.f; // no new requests are started after this much time in a frame
+};
+
+// call once per world, the scheduler and its workers belong to that world and go away with it
+void register_path_request_systems(flecs::world &ecs, const PathSchedulerSettings &settings);
@@ -2,6 +2,14 @@
 #include "dungeonUtils.h"
 #include "math.h"
 #include <algorithm>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <bit>
+#include "searchContext.h"
+#include "navCache.h"
 
 float heuristic(IVec2 lhs, IVec2 rhs)
 {
@@ -14,79 +22,70 @@ static size_t coord_to_idx(T x, T y, size_t w)
   return size_t(y) * w + size_t(x);
 }
 
-static std::vector<IVec2> reconstruct_path(std::vector<IVec2> prev, IVec2 to, size_t width)
+static void reconstruct_path(const SearchContext &ctx, size_t to_idx, size_t width,
+                             std::vector<IVec2> &out_path)
 {
-  IVec2 curPos = to;
-  std::vector<IVec2> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != IVec2{-1, -1})
-  {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
-  }
-  return res;
+  size_t len = 0;
+  for (size_t idx = to_idx; idx != invalid_node; idx = ctx.get_prev(idx))
+    ++len;
+  out_path.resize(len);
+  for (size_t idx = to_idx; idx != invalid_node; idx = ctx.get_prev(idx))
+    out_path[--len] = IVec2{int(idx % width), int(idx / width)};
 }
 
-static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IVec2 to,
-                                           IVec2 lim_min, IVec2 lim_max)
+bool find_path_a_star(SearchContext &ctx, const DungeonData &dd, IVec2 from, IVec2 to,
+                      IVec2 lim_min, IVec2 lim_max, std::vector<IVec2> &out_path,
+                      size_t *nodes_expanded)
 {
+  out_path.clear();
   if (from.x < 0 || from.y < 0 || from.x >= int(dd.width) || from.y >= int(dd.height))
-    return std::vector<IVec2>();
-  size_t inpSize = dd.width * dd.height;
-
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<IVec2> prev(inpSize, {-1,-1});
-
-  auto getG = [&](IVec2 p) -> float { return g[coord_to_idx(p.x, p.y, dd.width)]; };
-  auto getF = [&](IVec2 p) -> float { return f[coord_to_idx(p.x, p.y, dd.width)]; };
-
-  g[coord_to_idx(from.x, from.y, dd.width)] = 0;
-  f[coord_to_idx(from.x, from.y, dd.width)] = heuristic(from, to);
+    return false;
+  ctx.reset(dd.width * dd.height);
+  IndexedHeap &openList = ctx.openList;
 
-  std::vector<IVec2> openList = {from};
-  std::vector<IVec2> closedList;
+  const size_t fromIdx = coord_to_idx(from.x, from.y, dd.width);
+  ctx.set_g(fromIdx, 0.f, invalid_node);
+  ctx.set_state(fromIdx, NS_OPEN);
+  openList.push(fromIdx, heuristic(from, to));
 
   while (!openList.empty())
   {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
+    const size_t idx = openList.pop();
+    ctx.set_state(idx, NS_CLOSED);
+    const IVec2 curPos{int(idx % dd.width), int(idx / dd.width)};
+    if (curPos == to)
     {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
+      reconstruct_path(ctx, idx, dd.width, out_path);
+      return true;
     }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, dd.width);
-    IVec2 curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, dd.width);
-    closedList.emplace_back(curPos);
+    if (nodes_expanded)
+      ++*nodes_expanded;
+    const float curG = ctx.get_g(idx);
     auto checkNeighbour = [&](IVec2 p)
     {
       // out of bounds
       if (p.x < lim_min.x || p.y < lim_min.y || p.x >= lim_max.x || p.y >= lim_max.y)
         return;
-      size_t idx = coord_to_idx(p.x, p.y, dd.width);
+      size_t nidx = coord_to_idx(p.x, p.y, dd.width);
       // not empty
-      if (dd.tiles[idx] == dungeon::wall)
+      if (dd.tiles[nidx] == dungeon::wall)
+        return;
+      const uint8_t nstate = ctx.get_state(nidx);
+      if (nstate == NS_CLOSED)
         return;
       float edgeWeight = 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
+      float gScore = curG + 1.f * edgeWeight; // we're exactly 1 unit away
+      if (gScore >= ctx.get_g(nidx))
+        return;
+      ctx.set_g(nidx, gScore, idx);
+      const float fScore = gScore + heuristic(p, to);
+      if (nstate == NS_OPEN)
+        openList.decrease_key(nidx, fScore);
+      else
       {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + heuristic(p, to);
+        ctx.set_state(nidx, NS_OPEN);
+        openList.push(nidx, fScore);
       }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
     };
     checkNeighbour({curPos.x + 1, curPos.y + 0});
     checkNeighbour({curPos.x - 1, curPos.y + 0});
@@ -94,148 +93,1037 @@ static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IV
     checkNeighbour({curPos.x + 0, curPos.y - 1});
   }
   // empty path
-  return std::vector<IVec2>();
+  return false;
 }
 
+bool find_path_a_star(SearchContext &ctx, const DungeonData &dd, const DungeonComponents &dc,
+                      IVec2 from, IVec2 to, std::vector<IVec2> &out_path,
+                      size_t *nodes_expanded)
+{
+  if (!same_component(dd, dc, from, to))
+  {
+    out_path.clear();
+    return false;
+  }
+  return find_path_a_star(ctx, dd, from, to, IVec2{0, 0}, IVec2{int(dd.width), int(dd.height)},
+                          out_path, nodes_expanded);
+}
 
-void prebuild_map(flecs::world &ecs)
+// per worker scratch data for cluster floods
+struct ClusterFloodScratch
 {
-  auto mapQuery = ecs.query<const DungeonData>();
+  std::vector<int> dist;
+  std::vector<uint64_t> open; // walkable bits of the super tile
+  std::vector<uint64_t> visited;
+  std::vector<uint64_t> frontier;
+  std::vector<uint64_t> next;
+  std::vector<int> minDist;
+  size_t numFloods = 0;
+  size_t tilesVisited = 0;
+};
 
-  constexpr size_t splitTiles = 10;
-  ecs.defer([&]()
+// bfs over a single super tile, dist is indexed in local coords and is -1 for unreachable tiles
+// the wavefront is kept as bit rows, so every step grows up to 64 tiles at once
+// returns number of reached tiles
+static size_t flood_cluster(const WalkGrid &grid, IVec2 from, IVec2 lim_min, IVec2 lim_max,
+                            ClusterFloodScratch &scratch)
+{
+  const size_t clusterWidth = size_t(lim_max.x - lim_min.x);
+  const size_t clusterHeight = size_t(lim_max.y - lim_min.y);
+  const size_t rowWords = (clusterWidth + 63) / 64;
+  const size_t numWords = rowWords * clusterHeight;
+  std::vector<int> &dist = scratch.dist;
+  dist.assign(clusterWidth * clusterHeight, -1);
+  scratch.open.resize(numWords);
+  scratch.visited.assign(numWords, 0);
+  scratch.frontier.assign(numWords, 0);
+  scratch.next.resize(numWords);
+  for (size_t y = 0; y < clusterHeight; ++y)
+    for (size_t w = 0; w < rowWords; ++w)
+      scratch.open[y * rowWords + w] = grid.extract(size_t(lim_min.y) + y, size_t(lim_min.x) + w * 64,
+                                                    std::min(size_t(64), clusterWidth - w * 64));
+
+  const size_t fromX = size_t(from.x - lim_min.x);
+  const size_t fromY = size_t(from.y - lim_min.y);
+  const uint64_t fromBit = uint64_t(1) << (fromX % 64);
+  scratch.frontier[fromY * rowWords + fromX / 64] = fromBit;
+  scratch.visited[fromY * rowWords + fromX / 64] = fromBit;
+  dist[fromY * clusterWidth + fromX] = 0;
+  size_t numReached = 1;
+  for (int curDist = 1; ; ++curDist)
   {
-    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    bool grown = false;
+    for (size_t y = 0; y < clusterHeight; ++y)
+      for (size_t w = 0; w < rowWords; ++w)
+      {
+        const size_t i = y * rowWords + w;
+        const uint64_t *front = scratch.frontier.data();
+        uint64_t reach = (front[i] << 1) | (front[i] >> 1);
+        if (w > 0)
+          reach |= front[i - 1] >> 63;
+        if (w + 1 < rowWords)
+          reach |= front[i + 1] << 63;
+        if (y > 0)
+          reach |= front[i - rowWords];
+        if (y + 1 < clusterHeight)
+          reach |= front[i + rowWords];
+        scratch.next[i] = reach & scratch.open[i] & ~scratch.visited[i];
+        grown |= scratch.next[i] != 0;
+      }
+    if (!grown)
+      break;
+    for (size_t i = 0; i < numWords; ++i)
     {
-      // go through each super tile
-      const size_t width = dd.width / splitTiles;
-      const size_t height = dd.height / splitTiles;
-
-      auto check_border = [&](size_t xx, size_t yy,
-                              size_t dir_x, size_t dir_y,
-                              int offs_x, int offs_y,
-                              std::vector<PathPortal> &portals)
+      scratch.visited[i] |= scratch.next[i];
+      const size_t rowStart = (i / rowWords) * clusterWidth + (i % rowWords) * 64;
+      for (uint64_t bits = scratch.next[i]; bits != 0; bits &= bits - 1)
       {
-        int spanFrom = -1;
-        int spanTo = -1;
-        for (size_t i = 0; i < splitTiles; ++i)
-        {
-          size_t x = xx * splitTiles + i * dir_x;
-          size_t y = yy * splitTiles + i * dir_y;
-          size_t nx = x + offs_x;
-          size_t ny = y + offs_y;
-          if (dd.tiles[y * dd.width + x] != dungeon::wall &&
-              dd.tiles[ny * dd.width + nx] != dungeon::wall)
-          {
-            if (spanFrom < 0)
-              spanFrom = i;
-            spanTo = i;
-          }
-          else if (spanFrom >= 0)
-          {
-            // write span
-            portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                               yy * splitTiles + spanFrom * dir_y + offs_y,
-                               xx * splitTiles + spanTo * dir_x,
-                               yy * splitTiles + spanTo * dir_y});
-            spanFrom = -1;
-          }
-        }
-        if (spanFrom >= 0)
+        dist[rowStart + size_t(std::countr_zero(bits))] = curDist;
+        ++numReached;
+      }
+    }
+    std::swap(scratch.frontier, scratch.next);
+  }
+  return numReached;
+}
+
+// calls fn for every tile of the portal which lies inside of [lim_min, lim_max)
+template<typename Callable>
+static void for_each_portal_tile(const PathPortal &portal, IVec2 lim_min, IVec2 lim_max, Callable fn)
+{
+  for (size_t y = std::max(portal.startY, size_t(lim_min.y)); y <= std::min(portal.endY, size_t(lim_max.y - 1)); ++y)
+    for (size_t x = std::max(portal.startX, size_t(lim_min.x)); x <= std::min(portal.endX, size_t(lim_max.x - 1)); ++x)
+      fn(IVec2{int(x), int(y)});
+}
+
+static size_t cluster_of(const DungeonData &dd, size_t split_tiles, IVec2 p)
+{
+  return (size_t(p.y) / split_tiles) * (dd.width / split_tiles) + size_t(p.x) / split_tiles;
+}
+
+static void get_cluster_limits(const DungeonData &dd, size_t split_tiles, size_t cluster,
+                               IVec2 &lim_min, IVec2 &lim_max)
+{
+  const size_t width = dd.width / split_tiles;
+  lim_min = IVec2{int((cluster % width) * split_tiles), int((cluster / width) * split_tiles)};
+  lim_max = IVec2{lim_min.x + int(split_tiles), lim_min.y + int(split_tiles)};
+}
+
+struct PortalEdge
+{
+  size_t from;
+  size_t to;
+  float score;
+  size_t cluster;
+};
+
+// finds connections between all portals of a single super tile and appends them to edges
+static void connect_cluster_portals(const DungeonData &dd, const WalkGrid &grid, size_t split_tiles, size_t cluster,
+                                    const std::vector<size_t> &indices,
+                                    const std::vector<PathPortal> &portals,
+                                    ClusterFloodScratch &scratch, std::vector<PortalEdge> &edges)
+{
+  IVec2 lim_min, lim_max;
+  get_cluster_limits(dd, split_tiles, cluster, lim_min, lim_max);
+  const int clusterWidth = lim_max.x - lim_min.x;
+  std::vector<int> &minDist = scratch.minDist;
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    // one flood per tile of the first portal gives distances to all the other portals at once
+    // we keep the closest distance, or -1 if some pair of tiles has no path at all
+    minDist.assign(indices.size(), std::numeric_limits<int>::max());
+    for_each_portal_tile(portals[indices[i]], lim_min, lim_max, [&](IVec2 from)
+    {
+      scratch.tilesVisited += flood_cluster(grid, from, lim_min, lim_max, scratch);
+      ++scratch.numFloods;
+      for (size_t j = i + 1; j < indices.size(); ++j)
+        for_each_portal_tile(portals[indices[j]], lim_min, lim_max, [&](IVec2 to)
         {
-          portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                             yy * splitTiles + spanFrom * dir_y + offs_y,
-                             xx * splitTiles + spanTo * dir_x,
-                             yy * splitTiles + spanTo * dir_y});
-        }
-      };
-
-      std::vector<PathPortal> portals;
-      std::vector<std::vector<size_t>> tilePortalsIndices;
-
-      auto push_portals = [&](size_t x, size_t y,
-                              int offs_x, int offs_y,
-                              const std::vector<PathPortal> &new_portals)
+          const int d = scratch.dist[size_t((to.y - lim_min.y) * clusterWidth + to.x - lim_min.x)];
+          if (d < 0)
+            minDist[j] = -1;
+          else if (minDist[j] >= 0)
+            minDist[j] = std::min(minDist[j], d + 1); // path length in tiles
+        });
+    });
+    // write pathable data and length
+    for (size_t j = i + 1; j < indices.size(); ++j)
+      if (minDist[j] >= 0)
+        edges.push_back({indices[i], indices[j], float(minDist[j]), cluster});
+  }
+}
+
+// portal spans the border between two clusters, first one is top/left
+static void get_portal_clusters(const DungeonData &dd, size_t split_tiles, const PathPortal &portal,
+                                size_t &first, size_t &second)
+{
+  first = cluster_of(dd, split_tiles, IVec2{int(portal.startX), int(portal.startY)});
+  second = cluster_of(dd, split_tiles, IVec2{int(portal.endX), int(portal.endY)});
+}
+
+// middle tile of the portal on the side of the given cluster
+static IVec2 get_portal_tile(const DungeonData &dd, size_t split_tiles, const PathPortal &portal, size_t cluster)
+{
+  IVec2 limMin, limMax;
+  get_cluster_limits(dd, split_tiles, cluster, limMin, limMax);
+  const int x = std::clamp(int(portal.startX + portal.endX) / 2, limMin.x, limMax.x - 1);
+  const int y = std::clamp(int(portal.startY + portal.endY) / 2, limMin.y, limMax.y - 1);
+  return IVec2{x, y};
+}
+
+// distance in tiles (same units as portal connection scores) from flooded tile to each portal of the cluster
+static void link_tile_to_cluster(const DungeonData &dd, const DungeonPortals &dp, IVec2 pos, size_t cluster,
+                                 ClusterFloodScratch &scratch, std::vector<PortalConnection> &out_links)
+{
+  IVec2 limMin, limMax;
+  get_cluster_limits(dd, dp.tileSplit, cluster, limMin, limMax);
+  const int clusterWidth = limMax.x - limMin.x;
+  flood_cluster(dp.walkGrid, pos, limMin, limMax, scratch);
+  out_links.clear();
+  for (size_t portalIdx : dp.tilePortalsIndices[cluster])
+  {
+    int minDist = std::numeric_limits<int>::max();
+    for_each_portal_tile(dp.portals[portalIdx], limMin, limMax, [&](IVec2 p)
+    {
+      const int d = scratch.dist[size_t((p.y - limMin.y) * clusterWidth + p.x - limMin.x)];
+      if (d >= 0)
+        minDist = std::min(minDist, d + 1);
+    });
+    if (minDist != std::numeric_limits<int>::max())
+      out_links.push_back({portalIdx, float(minDist), cluster});
+  }
+}
+
+// cluster of the level above containing the given cluster of the level, level 0 is the portal graph itself
+static size_t parent_cluster(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster)
+{
+  const size_t width = level == 0 ? dd.width / dp.tileSplit : dp.levels[level - 1].width;
+  const PortalLevel &parent = dp.levels[level];
+  return (cluster / width) / parent.clusterRatio * parent.width + (cluster % width) / parent.clusterRatio;
+}
+
+// level 0 cluster to the one containing it on the given level
+static size_t lift_cluster(const DungeonData &dd, const DungeonPortals &dp, size_t cluster, size_t level)
+{
+  for (size_t l = 0; l < level; ++l)
+    cluster = parent_cluster(dd, dp, l, cluster);
+  return cluster;
+}
+
+static const std::vector<PortalConnection> &level_conns(const DungeonPortals &dp, size_t level, size_t portal)
+{
+  return level == 0 ? dp.portals[portal].conns : dp.levels[level - 1].conns[portal];
+}
+
+static IVec2 portal_center(const PathPortal &portal)
+{
+  return IVec2{int(portal.startX + portal.endX) / 2, int(portal.startY + portal.endY) / 2};
+}
+
+// dijkstra over portals of the level from seeds, follows only connections found inside of limit_cluster
+// of the level above, distances are left in ctx
+static void flood_portal_level(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t limit_cluster,
+                               const std::vector<PortalConnection> &seeds, SearchContext &ctx)
+{
+  ctx.reset(dp.portals.size());
+  IndexedHeap &openList = ctx.openList;
+  auto relax = [&](size_t next, float gScore, size_t prev)
+  {
+    const uint8_t nstate = ctx.get_state(next);
+    if (nstate == NS_CLOSED || gScore >= ctx.get_g(next))
+      return;
+    ctx.set_g(next, gScore, prev);
+    if (nstate == NS_OPEN)
+      openList.decrease_key(next, gScore);
+    else
+    {
+      ctx.set_state(next, NS_OPEN);
+      openList.push(next, gScore);
+    }
+  };
+  for (const PortalConnection &seed : seeds)
+    relax(seed.connIdx, seed.score, invalid_node);
+  while (!openList.empty())
+  {
+    const size_t node = openList.pop();
+    ctx.set_state(node, NS_CLOSED);
+    const float curG = ctx.get_g(node);
+    for (const PortalConnection &conn : level_conns(dp, level, node))
+      if (parent_cluster(dd, dp, level, conn.cluster) == limit_cluster)
+        relax(conn.connIdx, curG + conn.score, node);
+  }
+}
+
+// A* over portals of the level, start and goal are two extra nodes linked with the given connections
+// limit_cluster of the level above restricts connections to ones found inside of it, invalid_node allows all
+// writes portals between start and goal into out_chain
+static bool search_portal_level(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t limit_cluster,
+                                const std::vector<PortalConnection> &start_links,
+                                const std::vector<PortalConnection> &goal_links, float direct_score, IVec2 to,
+                                std::vector<size_t> &out_chain, float &out_cost)
+{
+  out_chain.clear();
+  const size_t numPortals = dp.portals.size();
+  const size_t startNode = numPortals;
+  const size_t goalNode = numPortals + 1;
+  auto nodeHeuristic = [&](size_t node) -> float
+  {
+    if (node >= numPortals)
+      return 0.f;
+    const PathPortal &portal = dp.portals[node];
+    return sqrtf(sqr(float(portal.startX + portal.endX) * 0.5f - float(to.x)) +
+                 sqr(float(portal.startY + portal.endY) * 0.5f - float(to.y)));
+  };
+  // negative for portals without a link to the goal, restored before returning
+  static thread_local std::vector<float> goalScore;
+  if (goalScore.size() < numPortals)
+    goalScore.resize(numPortals, -1.f);
+  for (const PortalConnection &link : goal_links)
+    goalScore[link.connIdx] = link.score;
+
+  SearchContext &ctx = get_thread_search_context();
+  ctx.reset(numPortals + 2);
+  IndexedHeap &openList = ctx.openList;
+  ctx.set_g(startNode, 0.f, invalid_node);
+  ctx.set_state(startNode, NS_OPEN);
+  openList.push(startNode, nodeHeuristic(startNode));
+  bool found = false;
+  while (!openList.empty())
+  {
+    const size_t node = openList.pop();
+    ctx.set_state(node, NS_CLOSED);
+    if (node == goalNode)
+    {
+      found = true;
+      break;
+    }
+    const float curG = ctx.get_g(node);
+    auto relax = [&](size_t next, float score)
+    {
+      const uint8_t nstate = ctx.get_state(next);
+      if (nstate == NS_CLOSED)
+        return;
+      const float gScore = curG + score;
+      if (gScore >= ctx.get_g(next))
+        return;
+      ctx.set_g(next, gScore, node);
+      const float fScore = gScore + nodeHeuristic(next);
+      if (nstate == NS_OPEN)
+        openList.decrease_key(next, fScore);
+      else
       {
-        for (const PathPortal &portal : new_portals)
-        {
-          size_t idx = portals.size();
-          portals.push_back(portal);
-          tilePortalsIndices[y * width + x].push_back(idx);
-          tilePortalsIndices[(y + offs_y) * width + x + offs_x].push_back(idx);
-        }
-      };
-      for (size_t y = 0; y < height; ++y)
-        for (size_t x = 0; x < width; ++x)
-        {
-          tilePortalsIndices.push_back(std::vector<size_t>{});
-          // check top
-          if (y > 0)
-          {
-            std::vector<PathPortal> topPortals;
-            check_border(x, y, 1, 0, 0, -1, topPortals);
-            push_portals(x, y, 0, -1, topPortals);
-          }
-          // left
-          if (x > 0)
-          {
-            std::vector<PathPortal> leftPortals;
-            check_border(x, y, 0, 1, -1, 0, leftPortals);
-            push_portals(x, y, -1, 0, leftPortals);
-          }
-        }
-      for (size_t tidx = 0; tidx < tilePortalsIndices.size(); ++tidx)
+        ctx.set_state(next, NS_OPEN);
+        openList.push(next, fScore);
+      }
+    };
+    if (node == startNode)
+    {
+      for (const PortalConnection &link : start_links)
+        relax(link.connIdx, link.score);
+      if (direct_score >= 0.f)
+        relax(goalNode, direct_score);
+      continue;
+    }
+    for (const PortalConnection &conn : level_conns(dp, level, node))
+      if (limit_cluster == invalid_node || parent_cluster(dd, dp, level, conn.cluster) == limit_cluster)
+        relax(conn.connIdx, conn.score);
+    if (goalScore[node] >= 0.f)
+      relax(goalNode, goalScore[node]);
+  }
+  for (const PortalConnection &link : goal_links)
+    goalScore[link.connIdx] = -1.f;
+  if (!found)
+    return false;
+
+  for (size_t node = ctx.get_prev(goalNode); node != startNode; node = ctx.get_prev(node))
+    out_chain.push_back(node);
+  std::reverse(out_chain.begin(), out_chain.end());
+  out_cost = ctx.get_g(goalNode);
+  return true;
+}
+
+// distances from a tile to the nodes of its cluster on the level above, links on the level itself
+// are the seeds, every hop stays inside of that cluster
+static void lift_links(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster,
+                       const std::vector<PortalConnection> &links, std::vector<PortalConnection> &out_links)
+{
+  SearchContext &ctx = get_thread_search_context();
+  flood_portal_level(dd, dp, level, cluster, links, ctx);
+  out_links.clear();
+  for (size_t portalIdx : dp.levels[level].clusterPortals[cluster])
+    if (ctx.get_g(portalIdx) != std::numeric_limits<float>::max())
+      out_links.push_back({portalIdx, ctx.get_g(portalIdx), cluster});
+}
+
+// replaces a chain of portals of the level with the chain of the level below going through the same clusters
+static bool refine_portal_chain(const DungeonData &dd, const DungeonPortals &dp, size_t level,
+                                size_t from_cluster, size_t to_cluster,
+                                const std::vector<PortalConnection> &start_links,
+                                const std::vector<PortalConnection> &goal_links, IVec2 to,
+                                std::vector<size_t> &chain)
+{
+  static thread_local std::vector<size_t> refined;
+  static thread_local std::vector<size_t> piece;
+  static thread_local std::vector<PortalConnection> pieceStart;
+  static thread_local std::vector<PortalConnection> pieceGoal;
+  refined.clear();
+  float cost = 0.f;
+  auto append = [&]()
+  {
+    const size_t skip = !refined.empty() && !piece.empty() && refined.back() == piece.front() ? 1 : 0;
+    refined.insert(refined.end(), piece.begin() + ptrdiff_t(skip), piece.end());
+  };
+  // from the start to the first portal inside of the start cluster
+  pieceGoal.assign(1, PortalConnection{chain.front(), 0.f, from_cluster});
+  if (!search_portal_level(dd, dp, level - 1, from_cluster, start_links, pieceGoal, -1.f,
+                           portal_center(dp.portals[chain.front()]), piece, cost))
+    return false;
+  append();
+  for (size_t i = 0; i + 1 < chain.size(); ++i)
+  {
+    // the cheapest of the connections between the pair tells which cluster to refine in
+    const PortalConnection *best = nullptr;
+    for (const PortalConnection &conn : level_conns(dp, level, chain[i]))
+      if (conn.connIdx == chain[i + 1] && (!best || conn.score < best->score))
+        best = &conn;
+    if (!best)
+      return false;
+    pieceStart.assign(1, PortalConnection{chain[i], 0.f, best->cluster});
+    pieceGoal.assign(1, PortalConnection{chain[i + 1], 0.f, best->cluster});
+    if (!search_portal_level(dd, dp, level - 1, best->cluster, pieceStart, pieceGoal, -1.f,
+                             portal_center(dp.portals[chain[i + 1]]), piece, cost))
+      return false;
+    append();
+  }
+  // and from the last portal to the goal
+  pieceStart.assign(1, PortalConnection{chain.back(), 0.f, to_cluster});
+  if (!search_portal_level(dd, dp, level - 1, to_cluster, pieceStart, goal_links, -1.f, to, piece, cost))
+    return false;
+  append();
+  std::swap(chain, refined);
+  return true;
+}
+
+bool find_path_hierarchical(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to,
+                            HierarchicalPath &out_path)
+{
+  out_path.segments.clear();
+  out_path.nextSegment = 0;
+  out_path.cost = 0.f;
+  // also rejects walls and out of bounds tiles
+  if (!same_component(dd, dp.components, from, to))
+    return false;
+
+  const size_t split = dp.tileSplit;
+  const IVec2 clusteredMax{int((dd.width / split) * split), int((dd.height / split) * split)};
+  if (from.x >= clusteredMax.x || from.y >= clusteredMax.y || to.x >= clusteredMax.x || to.y >= clusteredMax.y)
+  {
+    // leftover tiles outside of super tiles, resort to a single full map segment
+    out_path.segments.push_back({from, to, IVec2{0, 0}, IVec2{int(dd.width), int(dd.height)}});
+    out_path.cost = heuristic(from, to);
+    return true;
+  }
+
+  // insert start and goal into their clusters
+  static thread_local ClusterFloodScratch scratch;
+  static thread_local std::vector<std::vector<PortalConnection>> startLinks(1);
+  static thread_local std::vector<std::vector<PortalConnection>> goalLinks(1);
+  const size_t fromCluster = cluster_of(dd, split, from);
+  const size_t toCluster = cluster_of(dd, split, to);
+  link_tile_to_cluster(dd, dp, from, fromCluster, scratch, startLinks[0]);
+  float directScore = -1.f;
+  if (fromCluster == toCluster)
+  {
+    IVec2 limMin, limMax;
+    get_cluster_limits(dd, split, fromCluster, limMin, limMax);
+    const int d = scratch.dist[size_t((to.y - limMin.y) * (limMax.x - limMin.x) + to.x - limMin.x)];
+    if (d >= 0)
+      directScore = float(d + 1);
+  }
+  link_tile_to_cluster(dd, dp, to, toCluster, scratch, goalLinks[0]);
+
+  // search on the coarsest level where start and goal are in different clusters,
+  // links to its nodes are found by going up through the levels below
+  size_t searchLevel = 0;
+  while (searchLevel < dp.levels.size() &&
+         lift_cluster(dd, dp, fromCluster, searchLevel + 1) != lift_cluster(dd, dp, toCluster, searchLevel + 1))
+    ++searchLevel;
+  startLinks.resize(std::max(startLinks.size(), searchLevel + 1));
+  goalLinks.resize(std::max(goalLinks.size(), searchLevel + 1));
+  for (size_t level = 1; level <= searchLevel; ++level)
+  {
+    lift_links(dd, dp, level - 1, lift_cluster(dd, dp, fromCluster, level), startLinks[level - 1], startLinks[level]);
+    lift_links(dd, dp, level - 1, lift_cluster(dd, dp, toCluster, level), goalLinks[level - 1], goalLinks[level]);
+  }
+  std::vector<size_t> chain;
+  if (!search_portal_level(dd, dp, searchLevel, invalid_node, startLinks[searchLevel], goalLinks[searchLevel],
+                           searchLevel == 0 ? directScore : -1.f, to, chain, out_path.cost))
+    return false;
+  // walk down to the portal graph
+  for (size_t level = searchLevel; level > 0; --level)
+    if (!refine_portal_chain(dd, dp, level, lift_cluster(dd, dp, fromCluster, level),
+                             lift_cluster(dd, dp, toCluster, level), startLinks[level - 1], goalLinks[level - 1],
+                             to, chain))
+      return false;
+
+  // convert portal chain into tile waypoints, each waypoint lies in the cluster where the next leg starts
+  auto addLimits = [&](size_t cluster, IVec2 &lim_min, IVec2 &lim_max)
+  {
+    IVec2 clMin, clMax;
+    get_cluster_limits(dd, split, cluster, clMin, clMax);
+    lim_min = IVec2{std::min(lim_min.x, clMin.x), std::min(lim_min.y, clMin.y)};
+    lim_max = IVec2{std::max(lim_max.x, clMax.x), std::max(lim_max.y, clMax.y)};
+  };
+  IVec2 prevPos = from;
+  size_t prevFirst = fromCluster;
+  size_t prevSecond = fromCluster;
+  for (size_t i = 0; i <= chain.size(); ++i)
+  {
+    IVec2 pos = to;
+    size_t first = toCluster;
+    size_t second = toCluster;
+    if (i < chain.size())
+    {
+      const PathPortal &portal = dp.portals[chain[i]];
+      get_portal_clusters(dd, split, portal, first, second);
+      // pick the side which will be shared with the next leg of the path
+      size_t nextFirst = toCluster;
+      size_t nextSecond = toCluster;
+      if (i + 1 < chain.size())
+        get_portal_clusters(dd, split, dp.portals[chain[i + 1]], nextFirst, nextSecond);
+      const bool secondShared = second == nextFirst || second == nextSecond;
+      pos = get_portal_tile(dd, split, portal, secondShared ? second : first);
+    }
+    IVec2 limMin = prevPos;
+    IVec2 limMax = prevPos;
+    addLimits(prevFirst, limMin, limMax);
+    addLimits(prevSecond, limMin, limMax);
+    addLimits(first, limMin, limMax);
+    addLimits(second, limMin, limMax);
+    out_path.segments.push_back({prevPos, pos, limMin, limMax});
+    prevPos = pos;
+    prevFirst = first;
+    prevSecond = second;
+  }
+  return true;
+}
+
+bool refine_next_segment(const DungeonData &dd, HierarchicalPath &path, std::vector<IVec2> &out_tiles)
+{
+  static thread_local std::vector<IVec2> segmentTiles;
+  while (path.nextSegment < path.segments.size())
+  {
+    const PathSegment &seg = path.segments[path.nextSegment++];
+    if (!find_path_a_star(get_thread_search_context(), dd, seg.from, seg.to, seg.limMin, seg.limMax, segmentTiles))
+    {
+      // should not happen with up to date portals, jumping to the next waypoint would walk through walls
+      path.valid = false;
+      path.nextSegment = path.segments.size();
+      return false;
+    }
+    const size_t skip = !out_tiles.empty() && out_tiles.back() == segmentTiles.front() ? 1 : 0;
+    out_tiles.insert(out_tiles.end(), segmentTiles.begin() + skip, segmentTiles.end());
+    return true;
+  }
+  return false;
+}
+
+// portals on the border between super tile (xx, yy) and its neighbour at (offs_x, offs_y)
+static void find_border_portals(const WalkGrid &grid, size_t split_tiles,
+                                size_t xx, size_t yy,
+                                size_t dir_x, size_t dir_y,
+                                int offs_x, int offs_y,
+                                std::vector<PathPortal> &portals)
+{
+  auto writeSpan = [&](size_t spanFrom, size_t spanTo)
+  {
+    portals.push_back({xx * split_tiles + spanFrom * dir_x + offs_x,
+                       yy * split_tiles + spanFrom * dir_y + offs_y,
+                       xx * split_tiles + spanTo * dir_x,
+                       yy * split_tiles + spanTo * dir_y});
+  };
+  // open border tiles are gathered into masks of 64, horizontal borders are just two row words and-ed together
+  bool hasSpan = false;
+  size_t spanFrom = 0;
+  size_t spanTo = 0;
+  for (size_t base = 0; base < split_tiles; base += 64)
+  {
+    const size_t count = std::min(size_t(64), split_tiles - base);
+    const size_t x = xx * split_tiles + base * dir_x;
+    const size_t y = yy * split_tiles + base * dir_y;
+    uint64_t open = 0;
+    if (dir_x > 0)
+      open = grid.extract(y, x, count) & grid.extract(y + offs_y, x, count);
+    else
+      for (size_t i = 0; i < count; ++i)
+        if (grid.walkable(int(x), int(y + i)) && grid.walkable(int(x) + offs_x, int(y + i)))
+          open |= uint64_t(1) << i;
+    while (open != 0)
+    {
+      const size_t start = size_t(std::countr_zero(open));
+      const size_t len = size_t(std::countr_one(open >> start));
+      if (hasSpan && spanTo + 1 == base + start)
+        spanTo = base + start + len - 1; // continues the span from the previous mask
+      else
       {
-        const std::vector<size_t> &indices = tilePortalsIndices[tidx];
-        size_t x = tidx % width;
-        size_t y = tidx / width;
-        IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
-        IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
-        for (size_t i = 0; i < indices.size(); ++i)
-        {
-          PathPortal &firstPortal = portals[indices[i]];
-          for (size_t j = i + 1; j < indices.size(); ++j)
-          {
-            PathPortal &secondPortal = portals[indices[j]];
-            // check path from i to j
-            // check each position (to find closest dist) (could be made more optimal)
-            bool noPath = false;
-            size_t minDist = 0xffffffff;
-            for (size_t fromY = std::max(firstPortal.startY, size_t(limMin.y));
-                        fromY <= std::min(firstPortal.endY, size_t(limMax.y - 1)) && !noPath; ++fromY)
-            {
-              for (size_t fromX = std::max(firstPortal.startX, size_t(limMin.x));
-                          fromX <= std::min(firstPortal.endX, size_t(limMax.x - 1)) && !noPath; ++fromX)
-              {
-                for (size_t toY = std::max(secondPortal.startY, size_t(limMin.y));
-                            toY <= std::min(secondPortal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
-                {
-                  for (size_t toX = std::max(secondPortal.startX, size_t(limMin.x));
-                              toX <= std::min(secondPortal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
-                  {
-                    IVec2 from{int(fromX), int(fromY)};
-                    IVec2 to{int(toX), int(toY)};
-                    std::vector<IVec2> path = find_path_a_star(dd, from, to, limMin, limMax);
-                    if (path.empty() && from != to)
-                    {
-                      noPath = true; // if we found that there's no path at all - we can break out
-                      break;
-                    }
-                    minDist = std::min(minDist, path.size());
-                  }
-                }
-              }
-            }
-            // write pathable data and length
-            if (noPath)
-              continue;
-            firstPortal.conns.push_back({indices[j], float(minDist)});
-            secondPortal.conns.push_back({indices[i], float(minDist)});
-          }
-        }
+        if (hasSpan)
+          writeSpan(spanFrom, spanTo);
+        hasSpan = true;
+        spanFrom = base + start;
+        spanTo = base + start + len - 1;
+      }
+      open = start + len >= 64 ? 0 : open & (~uint64_t(0) << (start + len));
+    }
+  }
+  if (hasSpan)
+    writeSpan(spanFrom, spanTo);
+}
+
+// top border of the super tile if is_top is set, left border otherwise
+static void find_border_portals(const WalkGrid &grid, size_t split_tiles, size_t xx, size_t yy, bool is_top,
+                                std::vector<PathPortal> &portals)
+{
+  if (is_top)
+    find_border_portals(grid, split_tiles, xx, yy, 1, 0, 0, -1, portals);
+  else
+    find_border_portals(grid, split_tiles, xx, yy, 0, 1, -1, 0, portals);
+}
+
+DungeonPortals build_portals(const DungeonData &dd, size_t split_tiles, size_t num_threads, PortalBuildStats *stats)
+{
+  const auto startTime = std::chrono::steady_clock::now();
+  WalkGrid grid = build_walk_grid(dd);
+  // go through each super tile
+  const size_t width = dd.width / split_tiles;
+  const size_t height = dd.height / split_tiles;
+
+  std::vector<PathPortal> portals;
+  std::vector<std::vector<size_t>> tilePortalsIndices;
+  auto push_portals = [&](size_t x, size_t y,
+                          int offs_x, int offs_y,
+                          const std::vector<PathPortal> &new_portals)
+  {
+    for (const PathPortal &portal : new_portals)
+    {
+      size_t idx = portals.size();
+      portals.push_back(portal);
+      tilePortalsIndices[y * width + x].push_back(idx);
+      tilePortalsIndices[(y + offs_y) * width + x + offs_x].push_back(idx);
+    }
+  };
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      tilePortalsIndices.push_back(std::vector<size_t>{});
+      // check top
+      if (y > 0)
+      {
+        std::vector<PathPortal> topPortals;
+        find_border_portals(grid, split_tiles, x, y, true, topPortals);
+        push_portals(x, y, 0, -1, topPortals);
+      }
+      // left
+      if (x > 0)
+      {
+        std::vector<PathPortal> leftPortals;
+        find_border_portals(grid, split_tiles, x, y, false, leftPortals);
+        push_portals(x, y, -1, 0, leftPortals);
       }
-      e.set(DungeonPortals{splitTiles, portals, tilePortalsIndices});
+    }
+
+  // clusters are split into contiguous ranges, one per worker, each worker writes into its own buffer
+  const size_t numClusters = tilePortalsIndices.size();
+  size_t numWorkers = num_threads > 0 ? num_threads : size_t(std::thread::hardware_concurrency());
+  numWorkers = std::max(size_t(1), std::min(numWorkers, numClusters));
+  std::vector<std::vector<PortalEdge>> workerEdges(numWorkers);
+  std::vector<ClusterFloodScratch> workerScratch(numWorkers);
+  auto processClusters = [&](size_t worker)
+  {
+    const size_t first = numClusters * worker / numWorkers;
+    const size_t last = numClusters * (worker + 1) / numWorkers;
+    for (size_t tidx = first; tidx < last; ++tidx)
+      connect_cluster_portals(dd, grid, split_tiles, tidx, tilePortalsIndices[tidx], portals,
+                              workerScratch[worker], workerEdges[worker]);
+  };
+  std::vector<std::thread> workers;
+  for (size_t worker = 1; worker < numWorkers; ++worker)
+    workers.emplace_back(processClusters, worker);
+  processClusters(0);
+  for (std::thread &worker : workers)
+    worker.join();
+
+  // merging in worker order gives exactly the same connection order as a serial build
+  for (size_t worker = 0; worker < numWorkers; ++worker)
+    for (const PortalEdge &edge : workerEdges[worker])
+    {
+      portals[edge.from].conns.push_back({edge.to, edge.score, edge.cluster});
+      portals[edge.to].conns.push_back({edge.from, edge.score, edge.cluster});
+    }
+  DungeonComponents components = build_components(grid);
+  if (stats)
+  {
+    stats->numThreads = numWorkers;
+    stats->numPortals = portals.size();
+    stats->numFloods = 0;
+    stats->tilesVisited = 0;
+    for (const ClusterFloodScratch &scratch : workerScratch)
+    {
+      stats->numFloods += scratch.numFloods;
+      stats->tilesVisited += scratch.tilesVisited;
+    }
+    stats->buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+  }
+  return DungeonPortals{split_tiles, portals, tilePortalsIndices, std::move(components), std::move(grid), {}};
+}
+
+// gathers portals on the border of the cluster of the level from super tiles inside of it
+static void collect_level_nodes(const DungeonData &dd, DungeonPortals &dp, size_t level, size_t cluster)
+{
+  PortalLevel &pl = dp.levels[level - 1];
+  size_t group = 1; // super tiles per cluster side
+  for (size_t l = 0; l < level; ++l)
+    group *= dp.levels[l].clusterRatio;
+  const size_t width = dd.width / dp.tileSplit;
+  const size_t height = dd.height / dp.tileSplit;
+  const size_t x0 = (cluster % pl.width) * group;
+  const size_t y0 = (cluster / pl.width) * group;
+  std::vector<size_t> &indices = pl.clusterPortals[cluster];
+  indices.clear();
+  for (size_t y = y0; y < std::min(y0 + group, height); ++y)
+    for (size_t x = x0; x < std::min(x0 + group, width); ++x)
+      for (size_t portalIdx : dp.tilePortalsIndices[y * width + x])
+      {
+        // portals between two super tiles of this cluster are listed twice and are not nodes anyway
+        size_t first, second;
+        get_portal_clusters(dd, dp.tileSplit, dp.portals[portalIdx], first, second);
+        if (lift_cluster(dd, dp, first, level) != lift_cluster(dd, dp, second, level))
+          indices.push_back(portalIdx);
+      }
+}
+
+// same as for super tiles, but floods go over the graph of the level below instead of tiles
+static void connect_level_cluster(const DungeonData &dd, const DungeonPortals &dp, size_t level, size_t cluster,
+                                  std::vector<PortalEdge> &edges)
+{
+  SearchContext &ctx = get_thread_search_context();
+  static thread_local std::vector<PortalConnection> seed(1);
+  const std::vector<size_t> &indices = dp.levels[level - 1].clusterPortals[cluster];
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    seed[0] = PortalConnection{indices[i], 0.f, cluster};
+    flood_portal_level(dd, dp, level - 1, cluster, seed, ctx);
+    for (size_t j = i + 1; j < indices.size(); ++j)
+      if (ctx.get_g(indices[j]) != std::numeric_limits<float>::max())
+        edges.push_back({indices[i], indices[j], ctx.get_g(indices[j]), cluster});
+  }
+}
+
+static void add_level_edges(PortalLevel &pl, const std::vector<PortalEdge> &edges)
+{
+  for (const PortalEdge &edge : edges)
+  {
+    pl.conns[edge.from].push_back({edge.to, edge.score, edge.cluster});
+    pl.conns[edge.to].push_back({edge.from, edge.score, edge.cluster});
+  }
+}
+
+// appends a level grouping ratio x ratio clusters of the current coarsest level
+static void build_portal_level(const DungeonData &dd, DungeonPortals &dp, size_t ratio, size_t num_threads)
+{
+  const size_t childWidth = dp.levels.empty() ? dd.width / dp.tileSplit : dp.levels.back().width;
+  const size_t childHeight = dp.levels.empty() ? dd.height / dp.tileSplit : dp.levels.back().height;
+  PortalLevel &pl = dp.levels.emplace_back();
+  pl.clusterRatio = ratio;
+  pl.width = (childWidth + ratio - 1) / ratio;
+  pl.height = (childHeight + ratio - 1) / ratio;
+  pl.clusterPortals.resize(pl.width * pl.height);
+  pl.conns.resize(dp.portals.size());
+  const size_t level = dp.levels.size();
+
+  // split between workers the same way as super tiles are
+  const size_t numClusters = pl.clusterPortals.size();
+  size_t numWorkers = num_threads > 0 ? num_threads : size_t(std::thread::hardware_concurrency());
+  numWorkers = std::max(size_t(1), std::min(numWorkers, numClusters));
+  std::vector<std::vector<PortalEdge>> workerEdges(numWorkers);
+  auto processClusters = [&](size_t worker)
+  {
+    const size_t first = numClusters * worker / numWorkers;
+    const size_t last = numClusters * (worker + 1) / numWorkers;
+    for (size_t cluster = first; cluster < last; ++cluster)
+    {
+      collect_level_nodes(dd, dp, level, cluster);
+      connect_level_cluster(dd, dp, level, cluster, workerEdges[worker]);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t worker = 1; worker < numWorkers; ++worker)
+    workers.emplace_back(processClusters, worker);
+  processClusters(0);
+  for (std::thread &worker : workers)
+    worker.join();
+  for (const std::vector<PortalEdge> &edges : workerEdges)
+    add_level_edges(pl, edges);
+}
+
+// portal from_idx is about to be moved into to_idx by the portal graph update, renumbers it on all levels
+static void move_level_node(const DungeonData &dd, DungeonPortals &dp, size_t from_idx, size_t to_idx)
+{
+  size_t first, second;
+  get_portal_clusters(dd, dp.tileSplit, dp.portals[from_idx], first, second);
+  for (size_t level = 1; level <= dp.levels.size(); ++level)
+  {
+    PortalLevel &pl = dp.levels[level - 1];
+    for (size_t cluster : {lift_cluster(dd, dp, first, level), lift_cluster(dd, dp, second, level)})
+    {
+      std::vector<size_t> &indices = pl.clusterPortals[cluster];
+      std::replace(indices.begin(), indices.end(), from_idx, to_idx);
+    }
+    for (const PortalConnection &conn : pl.conns[from_idx])
+      for (PortalConnection &backConn : pl.conns[conn.connIdx])
+        if (backConn.connIdx == from_idx)
+          backConn.connIdx = to_idx;
+    pl.conns[to_idx] = std::move(pl.conns[from_idx]);
+  }
+}
+
+void build_portal_levels(const DungeonData &dd, DungeonPortals &dp, const std::vector<size_t> &cluster_tiles,
+                         size_t num_threads, PortalBuildStats *stats)
+{
+  dp.levels.clear();
+  if (stats)
+    stats->levels.clear();
+  size_t prevTiles = dp.tileSplit;
+  for (size_t tiles : cluster_tiles)
+  {
+    // sizes which don't nest into the previous level can't form a coarser level, so the hierarchy stops there
+    if (tiles % prevTiles != 0 || tiles / prevTiles < 2)
+      return;
+    const auto startTime = std::chrono::steady_clock::now();
+    build_portal_level(dd, dp, tiles / prevTiles, num_threads);
+    prevTiles = tiles;
+    if (!stats)
+      continue;
+    const PortalLevel &pl = dp.levels.back();
+    PortalLevelStats &ls = stats->levels.emplace_back(PortalLevelStats{pl.width, pl.height, tiles, 0, 0, 0.0});
+    // every node and connection is listed from both of its sides
+    for (const std::vector<size_t> &indices : pl.clusterPortals)
+      ls.numNodes += indices.size();
+    for (const std::vector<PortalConnection> &conns : pl.conns)
+      ls.numConns += conns.size();
+    ls.numNodes /= 2;
+    ls.numConns /= 2;
+    ls.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+  }
+}
+
+void print_portal_build_stats(const PortalBuildStats &stats)
+{
+  printf("prebuild_map: %zu portals, %zu cluster floods, %zu tiles visited, %.3f ms on %zu threads\n",
+         stats.numPortals, stats.numFloods, stats.tilesVisited, stats.buildMs, stats.numThreads);
+  for (size_t i = 0; i < stats.levels.size(); ++i)
+  {
+    const PortalLevelStats &ls = stats.levels[i];
+    printf("portal level %zu: %zux%zu clusters of %zu tiles, %zu nodes, %zu connections, %.3f ms\n",
+           i + 1, ls.width, ls.height, ls.clusterTiles, ls.numNodes, ls.numConns, ls.buildMs);
+  }
+}
+
+void update_portals(const DungeonData &dd, DungeonPortals &dp, const std::vector<IVec2> &changed_tiles)
+{
+  update_walk_grid(dd, dp.walkGrid, changed_tiles);
+  update_components(dd, dp.components, changed_tiles);
+
+  const size_t split = dp.tileSplit;
+  const size_t width = dd.width / split;
+  const size_t height = dd.height / split;
+  std::vector<PathPortal> &portals = dp.portals;
+
+  // borders are keyed by the bottom/right super tile and a flag whether it's top or left one
+  std::vector<std::pair<size_t, bool>> borders;
+  std::vector<size_t> dirtyClusters;
+  auto addUnique = [](auto &vec, auto val)
+  {
+    if (std::find(vec.begin(), vec.end(), val) == vec.end())
+      vec.push_back(val);
+  };
+  for (const IVec2 &tile : changed_tiles)
+  {
+    const size_t x = size_t(tile.x) / split;
+    const size_t y = size_t(tile.y) / split;
+    if (tile.x < 0 || tile.y < 0 || x >= width || y >= height)
+      continue;
+    addUnique(dirtyClusters, y * width + x);
+    if (y > 0)
+      addUnique(borders, std::make_pair(y * width + x, true));
+    if (x > 0)
+      addUnique(borders, std::make_pair(y * width + x, false));
+    if (y + 1 < height)
+      addUnique(borders, std::make_pair((y + 1) * width + x, true));
+    if (x + 1 < width)
+      addUnique(borders, std::make_pair(y * width + x + 1, false));
+  }
+
+  // rescan borders, neighbours have to be reconnected only if portals on a shared border have changed
+  std::vector<size_t> removedPortals;
+  std::vector<std::pair<size_t, std::vector<PathPortal>>> addedPortals;
+  std::vector<PathPortal> newPortals;
+  std::vector<size_t> oldPortals;
+  for (const auto &[cluster, isTop] : borders)
+  {
+    const size_t neighbour = isTop ? cluster - width : cluster - 1;
+    newPortals.clear();
+    find_border_portals(dp.walkGrid, split, cluster % width, cluster / width, isTop, newPortals);
+    oldPortals.clear();
+    for (size_t portalIdx : dp.tilePortalsIndices[cluster])
+    {
+      size_t first, second;
+      get_portal_clusters(dd, split, portals[portalIdx], first, second);
+      if (first == neighbour)
+        oldPortals.push_back(portalIdx);
+    }
+    bool same = oldPortals.size() == newPortals.size();
+    for (size_t i = 0; i < oldPortals.size() && same; ++i)
+    {
+      const PathPortal &oldPortal = portals[oldPortals[i]];
+      same = std::any_of(newPortals.begin(), newPortals.end(), [&](const PathPortal &p)
+      {
+        return p.startX == oldPortal.startX && p.startY == oldPortal.startY &&
+               p.endX == oldPortal.endX && p.endY == oldPortal.endY;
+      });
+    }
+    if (same)
+      continue;
+    addUnique(dirtyClusters, cluster);
+    addUnique(dirtyClusters, neighbour);
+    removedPortals.insert(removedPortals.end(), oldPortals.begin(), oldPortals.end());
+    addedPortals.emplace_back(cluster, newPortals);
+  }
+
+  // drop connections which were found inside of dirty clusters
+  for (size_t cluster : dirtyClusters)
+    for (size_t portalIdx : dp.tilePortalsIndices[cluster])
+    {
+      std::vector<PortalConnection> &conns = portals[portalIdx].conns;
+      conns.erase(std::remove_if(conns.begin(), conns.end(),
+                                 [&](const PortalConnection &conn) { return conn.cluster == cluster; }),
+                  conns.end());
+    }
+
+  // same for coarser levels, clusters containing dirty super tiles lose their nodes and connections
+  std::vector<std::vector<size_t>> levelDirtyClusters(dp.levels.size());
+  for (size_t level = 1; level <= dp.levels.size(); ++level)
+  {
+    PortalLevel &pl = dp.levels[level - 1];
+    for (size_t cluster : dirtyClusters)
+      addUnique(levelDirtyClusters[level - 1], lift_cluster(dd, dp, cluster, level));
+    for (size_t cluster : levelDirtyClusters[level - 1])
+    {
+      for (size_t portalIdx : pl.clusterPortals[cluster])
+      {
+        std::vector<PortalConnection> &conns = pl.conns[portalIdx];
+        conns.erase(std::remove_if(conns.begin(), conns.end(),
+                                   [&](const PortalConnection &conn) { return conn.cluster == cluster; }),
+                    conns.end());
+      }
+      pl.clusterPortals[cluster].clear();
+    }
+  }
+
+  // remove stale portals, last portal is moved into the freed slot so indices stay dense
+  std::sort(removedPortals.begin(), removedPortals.end(), std::greater<size_t>());
+  for (size_t removedIdx : removedPortals)
+  {
+    auto unlinkCluster = [&](size_t cluster, size_t from_idx, size_t to_idx)
+    {
+      std::vector<size_t> &indices = dp.tilePortalsIndices[cluster];
+      auto it = std::find(indices.begin(), indices.end(), from_idx);
+      if (to_idx == invalid_node)
+        indices.erase(it);
+      else
+        *it = to_idx;
+    };
+    size_t first, second;
+    get_portal_clusters(dd, split, portals[removedIdx], first, second);
+    unlinkCluster(first, removedIdx, invalid_node);
+    unlinkCluster(second, removedIdx, invalid_node);
+    const size_t lastIdx = portals.size() - 1;
+    if (removedIdx != lastIdx)
+    {
+      move_level_node(dd, dp, lastIdx, removedIdx);
+      PathPortal &moved = portals[lastIdx];
+      get_portal_clusters(dd, split, moved, first, second);
+      unlinkCluster(first, lastIdx, removedIdx);
+      unlinkCluster(second, lastIdx, removedIdx);
+      for (const PortalConnection &conn : moved.conns)
+        for (PortalConnection &backConn : portals[conn.connIdx].conns)
+          if (backConn.connIdx == lastIdx)
+            backConn.connIdx = removedIdx;
+      portals[removedIdx] = std::move(moved);
+    }
+    portals.pop_back();
+  }
+  for (PortalLevel &pl : dp.levels)
+    pl.conns.resize(portals.size());
+  for (const auto &[cluster, borderPortals] : addedPortals)
+    for (const PathPortal &portal : borderPortals)
+    {
+      size_t first, second;
+      get_portal_clusters(dd, split, portal, first, second);
+      dp.tilePortalsIndices[first].push_back(portals.size());
+      dp.tilePortalsIndices[second].push_back(portals.size());
+      portals.push_back(portal);
+    }
+
+  // reconnect dirty clusters
+  static thread_local ClusterFloodScratch scratch;
+  static thread_local std::vector<PortalEdge> edges;
+  edges.clear();
+  for (size_t cluster : dirtyClusters)
+    connect_cluster_portals(dd, dp.walkGrid, split, cluster, dp.tilePortalsIndices[cluster], portals, scratch, edges);
+  for (const PortalEdge &edge : edges)
+  {
+    portals[edge.from].conns.push_back({edge.to, edge.score, edge.cluster});
+    portals[edge.to].conns.push_back({edge.from, edge.score, edge.cluster});
+  }
+
+  // reconnect dirty clusters of coarser levels, finer levels go first as floods run over them
+  for (size_t level = 1; level <= dp.levels.size(); ++level)
+  {
+    dp.levels[level - 1].conns.resize(portals.size());
+    edges.clear();
+    for (size_t cluster : levelDirtyClusters[level - 1])
+    {
+      collect_level_nodes(dd, dp, level, cluster);
+      connect_level_cluster(dd, dp, level, cluster, edges);
+    }
+    add_level_edges(dp.levels[level - 1], edges);
+  }
+}
+
+void prebuild_map(flecs::world &ecs, size_t num_threads, const std::vector<size_t> &cluster_tiles,
+                  const std::string &cache_path, bool verbose)
+{
+  auto mapQuery = ecs.query<const DungeonData>();
+
+  const size_t splitTiles = cluster_tiles.empty() ? 10 : cluster_tiles.front();
+  const std::vector<size_t> levelTiles(cluster_tiles.begin() + (cluster_tiles.empty() ? 0 : 1), cluster_tiles.end());
+  ecs.defer([&]()
+  {
+    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    {
+      PortalBuildStats stats;
+      DungeonPortals dp;
+      if (!cache_path.empty())
+        dp = load_or_build_portals(cache_path, dd, cluster_tiles, num_threads, verbose ? &stats : nullptr);
+      else
+      {
+        dp = build_portals(dd, splitTiles, num_threads, verbose ? &stats : nullptr);
+        build_portal_levels(dd, dp, levelTiles, num_threads, verbose ? &stats : nullptr);
+      }
+      // a cache hit builds nothing and leaves the stats empty
+      if (verbose && stats.numThreads > 0)
+        print_portal_build_stats(stats);
+      e.set(std::move(dp));
     });
   });
 }
-
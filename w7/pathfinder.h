@@ -1,11 +1,17 @@
 #pragma once
 #include <flecs.h>
 #include <vector>
+#include <string>
+#include "ecsTypes.h"
+#include "math.h"
+#include "searchContext.h"
+#include "dungeonComponents.h"
 
 struct PortalConnection
 {
   size_t connIdx;
   float score;
+  size_t cluster; // super tile where this connection was found
 };
 
 struct PathPortal
@@ -15,12 +21,96 @@ struct PathPortal
   std::vector<PortalConnection> conns;
 };
 
+// level of the hierarchy above the portal graph, its clusters group clusterRatio x clusterRatio clusters of the level below
+// nodes are the portals lying on borders between its clusters, so portal indices are shared by all levels
+struct PortalLevel
+{
+  size_t clusterRatio;
+  size_t width, height; // in clusters
+  std::vector<std::vector<size_t>> clusterPortals; // node portals on the border of each cluster
+  std::vector<std::vector<PortalConnection>> conns; // per portal, empty for portals inside of clusters
+};
+
 struct DungeonPortals
 {
   size_t tileSplit;
   std::vector<PathPortal> portals;
   std::vector<std::vector<size_t>> tilePortalsIndices;
+  DungeonComponents components;
+  WalkGrid walkGrid; // kept in sync with DungeonData by update_portals
+  std::vector<PortalLevel> levels; // coarser levels over the tileSplit super tiles, empty for a single level
+};
+
+// A* restricted to [lim_min, lim_max) box, writes path into out_path (cleared on failure)
+bool find_path_a_star(SearchContext &ctx, const DungeonData &dd, IVec2 from, IVec2 to,
+                      IVec2 lim_min, IVec2 lim_max, std::vector<IVec2> &out_path,
+                      size_t *nodes_expanded = nullptr);
+// A* over the whole map, queries between different components are rejected without a search
+bool find_path_a_star(SearchContext &ctx, const DungeonData &dd, const DungeonComponents &dc,
+                      IVec2 from, IVec2 to, std::vector<IVec2> &out_path,
+                      size_t *nodes_expanded = nullptr);
+
+// piece of a hierarchical path, refined into tiles only when requested
+struct PathSegment
+{
+  IVec2 from, to;
+  IVec2 limMin, limMax; // area where refinement search is allowed
+};
+
+struct HierarchicalPath
+{
+  std::vector<PathSegment> segments;
+  size_t nextSegment = 0;
+  float cost = 0.f; // estimated length in tiles
+  bool valid = true; // false once some segment couldn't be refined, tiles given out so far lead nowhere
 };
 
-void prebuild_map(flecs::world &ecs);
+// A* over the portal graph with start and goal temporarily linked into their super tiles
+// with several levels the search runs on the coarsest level separating start and goal, then the path
+// is refined level by level inside of the clusters it goes through
+bool find_path_hierarchical(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to,
+                            HierarchicalPath &out_path);
+// appends tiles of the next unrefined segment to out_tiles, returns false if the path is exhausted
+// or if the segment has no path, the latter also marks the whole path invalid
+bool refine_next_segment(const DungeonData &dd, HierarchicalPath &path, std::vector<IVec2> &out_tiles);
+
+struct PortalLevelStats
+{
+  size_t width, height; // in clusters
+  size_t clusterTiles;
+  size_t numNodes;
+  size_t numConns;
+  double buildMs;
+};
+
+// what a portal build did and how long it took, to see how it scales with threads and levels
+struct PortalBuildStats
+{
+  size_t numThreads = 0;
+  size_t numPortals = 0;
+  size_t numFloods = 0;
+  size_t tilesVisited = 0;
+  double buildMs = 0.0;
+  std::vector<PortalLevelStats> levels;
+};
+
+void print_portal_build_stats(const PortalBuildStats &stats);
+
+// num_threads == 0 uses all hardware threads, 1 builds serially on the calling thread
+DungeonPortals build_portals(const DungeonData &dd, size_t split_tiles, size_t num_threads = 0,
+                             PortalBuildStats *stats = nullptr);
+// adds coarser levels, cluster_tiles are their cluster sizes in tiles, each a multiple of the previous level one
+void build_portal_levels(const DungeonData &dd, DungeonPortals &dp, const std::vector<size_t> &cluster_tiles,
+                         size_t num_threads = 0, PortalBuildStats *stats = nullptr);
+// rescans borders and reconnects only super tiles affected by edited tiles, components and walk grid are updated as well
+// coarser levels are rebuilt from the updated portal graph
+// dd must already contain the edits
+void update_portals(const DungeonData &dd, DungeonPortals &dp, const std::vector<IVec2> &changed_tiles);
+
+// first cluster size is the one of portal super tiles, the rest are sizes of coarser levels
+// with cache_path set the result is loaded from there if it matches the map, and saved there otherwise,
+// only worth it for fixed or seeded maps, a map generated anew on every launch never matches
+// verbose prints build timings, thread count and per level sizes
+void prebuild_map(flecs::world &ecs, size_t num_threads = 0, const std::vector<size_t> &cluster_tiles = {10},
+                  const std::string &cache_path = {}, bool verbose = false);
 
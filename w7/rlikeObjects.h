@@ -10,5 +10,6 @@ struct MonsterSpawner
 {
   float timeToSpawn;
   float timeBetweenSpawns;
+  size_t burstSize = 1; // monsters spawned at once
 };
 
@@ -0,0 +1,93 @@
+#pragma once
+#include "indexedHeap.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+
+enum NodeState : uint8_t
+{
+  NS_UNSEEN = 0,
+  NS_OPEN,
+  NS_CLOSED
+};
+
+constexpr size_t invalid_node = std::numeric_limits<size_t>::max();
+
+// scratch storage for grid searches, meant to be kept per thread and reused between queries
+// node data is valid only if its generation stamp matches the current one, so reset is O(1)
+class SearchContext
+{
+  std::vector<float> g;
+  std::vector<size_t> prev;
+  std::vector<uint8_t> state;
+  std::vector<uint32_t> generation;
+  uint32_t curGeneration = 0;
+
+  void touch(size_t idx)
+  {
+    if (generation[idx] == curGeneration)
+      return;
+    generation[idx] = curGeneration;
+    g[idx] = std::numeric_limits<float>::max();
+    prev[idx] = invalid_node;
+    state[idx] = NS_UNSEEN;
+  }
+
+public:
+  IndexedHeap openList;
+
+  void reset(size_t num_nodes)
+  {
+    if (generation.size() < num_nodes)
+    {
+      g.resize(num_nodes);
+      prev.resize(num_nodes);
+      state.resize(num_nodes);
+      generation.resize(num_nodes, 0);
+    }
+    if (++curGeneration == 0)
+    {
+      // stamps wrapped around, invalidate everything explicitly
+      std::fill(generation.begin(), generation.end(), 0);
+      curGeneration = 1;
+    }
+    openList.reset(num_nodes);
+  }
+
+  float get_g(size_t idx) const
+  {
+    return generation[idx] == curGeneration ? g[idx] : std::numeric_limits<float>::max();
+  }
+
+  size_t get_prev(size_t idx) const
+  {
+    return generation[idx] == curGeneration ? prev[idx] : invalid_node;
+  }
+
+  uint8_t get_state(size_t idx) const
+  {
+    return generation[idx] == curGeneration ? state[idx] : uint8_t(NS_UNSEEN);
+  }
+
+  void set_g(size_t idx, float value, size_t prev_idx)
+  {
+    touch(idx);
+    g[idx] = value;
+    prev[idx] = prev_idx;
+  }
+
+  void set_state(size_t idx, uint8_t value)
+  {
+    touch(idx);
+    state[idx] = value;
+  }
+};
+
+// context for the calling thread, use it unless you manage contexts yourself
+inline SearchContext &get_thread_search_context()
+{
+  static thread_local SearchContext ctx;
+  return ctx;
+}
@@ -6,9 +6,25 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "pathfinder.h"
+#include "pathRequests.h"
 
 constexpr float tile_size = 64.f;
 
+// monsters chasing the player through the dungeon, paths come from the path request scheduler
+struct PathChaser
+{
+  std::vector<IVec2> path;
+  size_t nextTile = 0;
+  float timeToRepath = 0.f;
+};
+
+constexpr float chaser_repath_time = 1.f;
+
+static IVec2 to_tile(const Position &pos)
+{
+  return IVec2{int((pos.x + tile_size * 0.5f) / tile_size), int((pos.y + tile_size * 0.5f) / tile_size)};
+}
+
 static void register_roguelike_systems(flecs::world &ecs)
 {
   static auto playerPosQuery = ecs.query<const Position, const IsPlayer>();
@@ -64,15 +80,27 @@ static void register_roguelike_systems(flecs::world &ecs)
         ms.timeToSpawn -= ecs.delta_time();
         while (ms.timeToSpawn < 0.f)
         {
-          steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
-          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
-          const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
-          const float dist = distances[st];
-          constexpr int angRandMax = 1 << 16;
-          const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
-          Color col = colors[st];
-          steer::create_steer_beh(create_monster(ecs,
-              {pp.x + cosf(angle) * dist, pp.y + sinf(angle) * dist}, col, "minotaur_tex"), st);
+          for (size_t i = 0; i < ms.burstSize; ++i)
+          {
+            steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
+            const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
+            const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
+            const float dist = distances[st];
+            constexpr int angRandMax = 1 << 16;
+            const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
+            Color col = colors[st];
+            const Position spawnPos{pp.x + cosf(angle) * dist, pp.y + sinf(angle) * dist};
+            if (st == steer::StEvader || st == steer::StFleer)
+            {
+              steer::create_steer_beh(create_monster(ecs, spawnPos, col, "minotaur_tex"), st);
+              continue;
+            }
+            // chasers go around walls, so they have to start on a floor tile
+            const IVec2 tile = to_tile(spawnPos);
+            const Position tilePos = dungeon::is_tile_walkable(ecs, Position{float(tile.x), float(tile.y)})
+                                     ? Position{float(tile.x), float(tile.y)} : dungeon::find_walkable_tile(ecs);
+            create_monster(ecs, tilePos * tile_size, col, "minotaur_tex").set(PathChaser{});
+          }
           ms.timeToSpawn += ms.timeBetweenSpawns;
         }
       });
@@ -112,6 +140,22 @@ static void register_roguelike_systems(flecs::world &ecs)
             }
           }
         }
+        // hierarchical path from player to the tile under cursor
+        playerPosQuery.each([&](const Position &pp, const IsPlayer &)
+        {
+          IVec2 from{int((pp.x + tile_size * 0.5f) / tile_size), int((pp.y + tile_size * 0.5f) / tile_size)};
+          IVec2 to{int(mousePosition.x / tile_size), int(mousePosition.y / tile_size)};
+          HierarchicalPath path;
+          if (!find_path_hierarchical(dd, dp, from, to, path))
+            return;
+          std::vector<IVec2> tiles;
+          while (refine_next_segment(dd, path, tiles)) {}
+          if (!path.valid)
+            return;
+          for (const IVec2 &t : tiles)
+            DrawRectangleRec(Rectangle{t.x * tile_size, t.y * tile_size, tile_size, tile_size},
+                             GetColor(0x44000088));
+        });
         for (const PathPortal &portal : dp.portals)
         {
           Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
@@ -138,6 +182,44 @@ static void register_roguelike_systems(flecs::world &ecs)
       });
     });
   steer::register_systems(ecs);
+
+  // a whole burst asks for paths at once, the scheduler spreads them over frames instead of stalling one
+  ecs.system<PathChaser, const Position>()
+    .each([&](flecs::entity e, PathChaser &pc, const Position &pos)
+    {
+      pc.timeToRepath -= ecs.delta_time();
+      if (pc.timeToRepath > 0.f)
+        return;
+      pc.timeToRepath = chaser_repath_time;
+      playerPosQuery.each([&](const Position &pp, const IsPlayer &)
+      {
+        e.set(PathRequest{to_tile(pos), to_tile(pp)});
+      });
+    });
+  ecs.system<PathChaser, const PathResult>()
+    .each([&](flecs::entity e, PathChaser &pc, const PathResult &res)
+    {
+      pc.path = res.path;
+      pc.nextTile = 1; // first tile is the one the request started from
+      e.remove<PathResult>();
+    });
+  ecs.system<Velocity, PathChaser, const Position, const MoveSpeed>()
+    .each([&](Velocity &vel, PathChaser &pc, const Position &pos, const MoveSpeed &ms)
+    {
+      vel = Velocity{0.f, 0.f};
+      while (pc.nextTile < pc.path.size())
+      {
+        const IVec2 tile = pc.path[pc.nextTile];
+        const Position delta = Position{float(tile.x) * tile_size, float(tile.y) * tile_size} - pos;
+        if (length(delta) > ms.speed * ecs.delta_time())
+        {
+          vel = Velocity{normalize(delta) * ms.speed};
+          return;
+        }
+        ++pc.nextTile;
+      }
+    });
+  register_path_request_systems(ecs, PathSchedulerSettings{1, 1000.f});
 }
 
 
@@ -152,6 +234,9 @@ void init_shoot_em_up(flecs::world &ecs)
 
   const Position walkableTile = dungeon::find_walkable_tile(ecs);
   create_player(ecs, walkableTile * tile_size, "swordsman_tex");
+
+  ecs.entity("monster_spawner")
+    .set(MonsterSpawner{2.f, 15.f, 8});
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
@@ -182,7 +267,8 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
       else if (tile == dungeon::floor)
         tileEntity.add<TextureSource>(floorTex);
     }
-  prebuild_map(ecs);
+  // the map is generated from the clock every launch, a cache would never match it
+  prebuild_map(ecs, 0, {10}, {}, true);
 }
 
 void process_game(flecs::world &ecs)
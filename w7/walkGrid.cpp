@@ -0,0 +1,56 @@
+#include "walkGrid.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <bit>
+
+size_t WalkGrid::find_next(size_t y, size_t from, bool walkable) const
+{
+  if (from >= width)
+    return width;
+  const uint64_t *r = row(y);
+  const uint64_t flip = walkable ? 0 : ~uint64_t(0);
+  size_t word = from / 64;
+  uint64_t cur = (r[word] ^ flip) & (~uint64_t(0) << (from % 64));
+  while (cur == 0)
+  {
+    if (++word == wordsPerRow)
+      return width;
+    cur = r[word] ^ flip;
+  }
+  // padding bits are zero, so a search for a wall may end up past the width
+  return std::min(width, word * 64 + size_t(std::countr_zero(cur)));
+}
+
+WalkGrid build_walk_grid(const DungeonData &dd)
+{
+  WalkGrid grid;
+  grid.width = dd.width;
+  grid.height = dd.height;
+  grid.wordsPerRow = (dd.width + 63) / 64;
+  grid.bits.assign(grid.wordsPerRow * dd.height, 0);
+  for (size_t y = 0; y < dd.height; ++y)
+  {
+    uint64_t *row = grid.bits.data() + y * grid.wordsPerRow;
+    for (size_t x = 0; x < dd.width; ++x)
+      if (dd.tiles[y * dd.width + x] != dungeon::wall)
+        row[x / 64] |= uint64_t(1) << (x % 64);
+  }
+  return grid;
+}
+
+void update_walk_grid(const DungeonData &dd, WalkGrid &grid, const std::vector<IVec2> &changed_tiles)
+{
+  for (const IVec2 &tile : changed_tiles)
+  {
+    if (tile.x < 0 || tile.y < 0 || tile.x >= int(dd.width) || tile.y >= int(dd.height))
+      continue;
+    const size_t x = size_t(tile.x);
+    const size_t y = size_t(tile.y);
+    uint64_t &word = grid.bits[y * grid.wordsPerRow + x / 64];
+    const uint64_t bit = uint64_t(1) << (x % 64);
+    if (dd.tiles[y * dd.width + x] != dungeon::wall)
+      word |= bit;
+    else
+      word &= ~bit;
+  }
+}
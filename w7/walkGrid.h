@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "ecsTypes.h"
+#include "math.h"
+
+// walkability of DungeonData packed 1 bit per tile, so floods can process 64 tiles per operation
+// every row starts at a word boundary, bits past the width are always zero
+struct WalkGrid
+{
+  size_t width = 0;
+  size_t height = 0;
+  size_t wordsPerRow = 0;
+  std::vector<uint64_t> bits;
+
+  const uint64_t *row(size_t y) const { return bits.data() + y * wordsPerRow; }
+
+  bool walkable(int x, int y) const
+  {
+    if (x < 0 || y < 0 || x >= int(width) || y >= int(height))
+      return false;
+    return (row(size_t(y))[size_t(x) / 64] >> (size_t(x) % 64)) & 1;
+  }
+
+  // count (up to 64) bits of row y starting at x, bit 0 is tile x
+  uint64_t extract(size_t y, size_t x, size_t count) const
+  {
+    const uint64_t *r = row(y);
+    const size_t word = x / 64;
+    const size_t shift = x % 64;
+    uint64_t res = r[word] >> shift;
+    if (shift > 0 && word + 1 < wordsPerRow)
+      res |= r[word + 1] << (64 - shift);
+    return count >= 64 ? res : res & ((uint64_t(1) << count) - 1);
+  }
+
+  // first x >= from in row y with the given walkability, width if there's none
+  size_t find_next(size_t y, size_t from, bool walkable) const;
+};
+
+WalkGrid build_walk_grid(const DungeonData &dd);
+// dd must already contain the edits
+void update_walk_grid(const DungeonData &dd, WalkGrid &grid, const std::vector<IVec2> &changed_tiles);